@@ -0,0 +1,175 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+/*
+ * The scanners are internal to the matcher, so its source is built in here
+ * rather than linked, to time the matcher with each of them in turn.
+ */
+#include "libinvenio/invenio-fuzzy.c"
+
+#include "invenio-benchmark.h"
+
+typedef struct InvenioBenchmarkFind
+{
+    const gchar        *name;
+    InvenioFuzzyFind    find;
+} InvenioBenchmarkFind;
+
+
+static const gchar * const InvenioBenchmarkPatterns[] =
+{
+    "lo", "rep", "ec", "cafe", "qrd", "vacphot", "xyz",
+};
+
+
+static GPtrArray *
+_prepare_texts (const GPtrArray * const corpus,
+                gsize                  *bytes)
+{
+    GPtrArray *texts;
+    guint i;
+
+    texts = g_ptr_array_new_with_free_func ((GDestroyNotify) invenio_fuzzy_text_free);
+    *bytes = 0;
+
+    for (i = 0; i < corpus->len; i++)
+    {
+        g_ptr_array_add (texts, invenio_fuzzy_text_new (g_ptr_array_index (corpus, i)));
+        *bytes += strlen (g_ptr_array_index (corpus, i));
+    }
+
+    return texts;
+}
+
+static GPtrArray *
+_prepare_patterns (void)
+{
+    GPtrArray *patterns;
+    guint i;
+
+    patterns = g_ptr_array_new_with_free_func ((GDestroyNotify) invenio_fuzzy_pattern_free);
+
+    for (i = 0; i < G_N_ELEMENTS (InvenioBenchmarkPatterns); i++)
+        g_ptr_array_add (patterns, invenio_fuzzy_pattern_new (InvenioBenchmarkPatterns[i]));
+
+    return patterns;
+}
+
+/* the ASCII matcher with the given scanner, every pattern against every title */
+static void
+_benchmark_match_ascii (const InvenioBenchmarkFind * const  find,
+                        const GPtrArray * const             patterns,
+                        const GPtrArray * const             texts,
+                        const gsize                         bytes)
+{
+    guint pass, i, j, operations = 0;
+    gsize matches = 0;
+    gint64 start;
+    gchar *name;
+    gint score;
+
+    start = g_get_monotonic_time ();
+
+    for (pass = 0; pass < INVENIO_BENCHMARK_PASSES; pass++)
+        for (i = 0; i < patterns->len; i++)
+            for (j = 0; j < texts->len; j++, operations++)
+                matches += _match_ascii (g_ptr_array_index (patterns, i),
+                                         g_ptr_array_index (texts, j),
+                                         find->find, &score);
+
+    name = g_strdup_printf ("fuzzy match, ascii, %s", find->name);
+    invenio_benchmark_report (name, g_get_monotonic_time () - start, operations,
+                              bytes * patterns->len * INVENIO_BENCHMARK_PASSES);
+    invenio_benchmark_sink += matches;
+
+    g_free (name);
+}
+
+static void
+_benchmark_match (const gchar * const       name,
+                  const GPtrArray * const   patterns,
+                  const GPtrArray * const   texts,
+                  const gsize               bytes)
+{
+    guint pass, i, j, operations = 0;
+    gsize matches = 0;
+    gdouble score;
+    gint64 start;
+
+    start = g_get_monotonic_time ();
+
+    for (pass = 0; pass < INVENIO_BENCHMARK_PASSES; pass++)
+        for (i = 0; i < patterns->len; i++)
+            for (j = 0; j < texts->len; j++, operations++)
+                matches += invenio_fuzzy_pattern_match (g_ptr_array_index (patterns, i),
+                                                        g_ptr_array_index (texts, j),
+                                                        &score);
+
+    invenio_benchmark_report (name, g_get_monotonic_time () - start, operations,
+                              bytes * patterns->len * INVENIO_BENCHMARK_PASSES);
+    invenio_benchmark_sink += matches;
+}
+
+void
+invenio_benchmark_fuzzy (void)
+{
+    InvenioBenchmarkFind finds[3];
+    GPtrArray *patterns, *texts;
+    guint i, count = 0;
+    gsize bytes;
+
+    finds[count].name = "scalar";
+    finds[count++].find = _find_scalar;
+#if defined(INVENIO_FUZZY_HAVE_SSE2)
+    finds[count].name = "sse2";
+    finds[count++].find = _find_sse2;
+#endif
+#if defined(INVENIO_FUZZY_HAVE_AVX2)
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+    {
+        finds[count].name = "avx2";
+        finds[count++].find = _find_avx2;
+    }
+#endif
+
+    patterns = _prepare_patterns ();
+
+    texts = _prepare_texts (invenio_benchmark_get_corpus (INVENIO_BENCHMARK_CORPUS_ASCII), &bytes);
+    for (i = 0; i < count; i++)
+        _benchmark_match_ascii (&finds[i], patterns, texts, bytes);
+    g_ptr_array_free (texts, TRUE);
+
+    texts = _prepare_texts (invenio_benchmark_get_corpus (INVENIO_BENCHMARK_CORPUS_UNICODE), &bytes);
+    _benchmark_match ("fuzzy match, unicode", patterns, texts, bytes);
+    g_ptr_array_free (texts, TRUE);
+
+    g_ptr_array_free (patterns, TRUE);
+}
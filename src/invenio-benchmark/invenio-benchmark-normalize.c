@@ -0,0 +1,133 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+/*
+ * The ASCII fast path is internal to the normalizer, so its source is built
+ * in here rather than linked, to time the paths separately.
+ */
+#include "libinvenio/invenio-normalize.c"
+
+#include "invenio-benchmark.h"
+
+typedef gboolean (*InvenioBenchmarkLower)(const guchar * const text, guchar * const output, const gsize length);
+typedef gchar *(*InvenioBenchmarkNormalize)(const gchar * const text);
+
+
+static gsize
+_corpus_bytes (const GPtrArray * const corpus)
+{
+    gsize bytes = 0;
+    guint i;
+
+    for (i = 0; i < corpus->len; i++)
+        bytes += strlen (g_ptr_array_index (corpus, i));
+
+    return bytes;
+}
+
+static gboolean
+_lower_scalar (const guchar * const text,
+               guchar * const       output,
+               const gsize          length)
+{
+    return _lower_ascii_scalar (text, output, 0, length);
+}
+
+static void
+_benchmark_lower (const gchar * const       name,
+                  InvenioBenchmarkLower     lower,
+                  const GPtrArray * const   corpus)
+{
+    guint pass, i, operations = 0;
+    const gchar *text;
+    gsize lowered = 0;
+    guchar *output;
+    gint64 start;
+
+    output = g_malloc (_corpus_bytes (corpus) + 1);
+
+    start = g_get_monotonic_time ();
+
+    for (pass = 0; pass < INVENIO_BENCHMARK_PASSES; pass++)
+        for (i = 0; i < corpus->len; i++, operations++)
+        {
+            text = g_ptr_array_index (corpus, i);
+            lowered += lower ((const guchar *) text, output, strlen (text));
+        }
+
+    invenio_benchmark_report (name, g_get_monotonic_time () - start, operations,
+                              _corpus_bytes (corpus) * INVENIO_BENCHMARK_PASSES);
+    invenio_benchmark_sink += lowered;
+
+    g_free (output);
+}
+
+static void
+_benchmark_normalize (const gchar * const       name,
+                      InvenioBenchmarkNormalize normalize,
+                      const GPtrArray * const   corpus)
+{
+    guint pass, i, operations = 0;
+    gchar *normalized;
+    gsize bytes = 0;
+    gint64 start;
+
+    start = g_get_monotonic_time ();
+
+    for (pass = 0; pass < INVENIO_BENCHMARK_PASSES; pass++)
+        for (i = 0; i < corpus->len; i++, operations++)
+        {
+            normalized = normalize (g_ptr_array_index (corpus, i));
+            bytes += strlen (normalized);
+            g_free (normalized);
+        }
+
+    invenio_benchmark_report (name, g_get_monotonic_time () - start, operations,
+                              _corpus_bytes (corpus) * INVENIO_BENCHMARK_PASSES);
+    invenio_benchmark_sink += bytes;
+}
+
+void
+invenio_benchmark_normalize (void)
+{
+    const GPtrArray *ascii, *unicode;
+
+    ascii = invenio_benchmark_get_corpus (INVENIO_BENCHMARK_CORPUS_ASCII);
+    unicode = invenio_benchmark_get_corpus (INVENIO_BENCHMARK_CORPUS_UNICODE);
+
+    _benchmark_lower ("lowercase, ascii, scalar", _lower_scalar, ascii);
+#if defined(INVENIO_NORMALIZE_HAVE_SSE2)
+    _benchmark_lower ("lowercase, ascii, sse2", _lower_ascii_sse2, ascii);
+#endif
+
+    _benchmark_normalize ("normalize, ascii", invenio_normalize, ascii);
+    _benchmark_normalize ("normalize, ascii, without fast path", _normalize_utf8, ascii);
+    _benchmark_normalize ("normalize, unicode", invenio_normalize, unicode);
+}
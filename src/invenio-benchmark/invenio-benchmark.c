@@ -0,0 +1,127 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "invenio-benchmark.h"
+
+#define INVENIO_BENCHMARK_CORPUS_SIZE           (1000)
+#define INVENIO_BENCHMARK_CORPUS_SEED           (0x1ee7)
+#define INVENIO_BENCHMARK_TITLE_WORDS           (6)
+
+
+/* keeps the compiler from discarding the work being timed */
+volatile gsize invenio_benchmark_sink;
+
+static const gchar * const InvenioBenchmarkWords[INVENIO_BENCHMARK_CORPORA][16] =
+{
+    [INVENIO_BENCHMARK_CORPUS_ASCII]    = {
+        "LibreOffice", "Writer", "Quarterly", "report", "draft", "final",
+        "vacation", "photos", "2010", "invoice", "Music", "Library",
+        "README", "backup", "screenshot", "presentation",
+    },
+    [INVENIO_BENCHMARK_CORPUS_UNICODE]  = {
+        "Écran", "café", "naïve", "Straße", "Ωmega", "Größe",
+        "résumé", "Øresund", "São", "Paulo", "東京", "fiancée",
+        "Crème", "brûlée", "report", "photos",
+    },
+};
+
+static GPtrArray *corpora[INVENIO_BENCHMARK_CORPORA];
+
+
+/* titles made up of words picked with a fixed seed, so runs are comparable */
+static GPtrArray *
+_generate_corpus (const InvenioBenchmarkCorpus corpus)
+{
+    GPtrArray *titles;
+    GString *title;
+    GRand *rand;
+    guint i, j;
+
+    titles = g_ptr_array_new_with_free_func (g_free);
+    rand = g_rand_new_with_seed (INVENIO_BENCHMARK_CORPUS_SEED);
+
+    for (i = 0; i < INVENIO_BENCHMARK_CORPUS_SIZE; i++)
+    {
+        title = g_string_new (NULL);
+
+        for (j = g_rand_int_range (rand, 1, INVENIO_BENCHMARK_TITLE_WORDS + 1); j > 0; j--)
+        {
+            g_string_append (title, InvenioBenchmarkWords[corpus][g_rand_int_range (rand, 0, 16)]);
+            if (j > 1)
+                g_string_append_c (title, ' ');
+        }
+
+        g_ptr_array_add (titles, g_string_free (title, FALSE));
+    }
+
+    g_rand_free (rand);
+
+    return titles;
+}
+
+const GPtrArray *
+invenio_benchmark_get_corpus (const InvenioBenchmarkCorpus corpus)
+{
+    if (! corpora[corpus])
+        corpora[corpus] = _generate_corpus (corpus);
+
+    return corpora[corpus];
+}
+
+/* elapsed is in microseconds */
+void
+invenio_benchmark_report (const gchar * const   name,
+                          const gint64          elapsed,
+                          const guint           operations,
+                          const gsize           bytes)
+{
+    g_print ("%-40s %10.1f ns/op %10.1f MB/s\n",
+             name,
+             elapsed * 1000.0 / MAX (operations, 1),
+             bytes / (MAX (elapsed, 1) / (gdouble) G_USEC_PER_SEC) / (1024.0 * 1024.0));
+}
+
+int
+main (int argc, char **argv)
+{
+    InvenioBenchmarkCorpus corpus;
+
+    invenio_benchmark_fuzzy ();
+    invenio_benchmark_normalize ();
+
+    for (corpus = (InvenioBenchmarkCorpus) 0; corpus != INVENIO_BENCHMARK_CORPORA; corpus++)
+        if (corpora[corpus])
+            g_ptr_array_free (corpora[corpus], TRUE);
+
+    return EXIT_SUCCESS;
+}
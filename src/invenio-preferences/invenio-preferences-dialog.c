@@ -28,10 +28,13 @@
  * OF SUCH DAMAGE.
  **/
 
+#include <string.h>
+
 #include "invenio-preferences-dialog.h"
 
 #include "libinvenio/invenio-category.h"
 #include "libinvenio/invenio-configuration.h"
+#include "libinvenio/invenio-remote.h"
 
 
 typedef enum InvenioPreferencesCategoryColumn
@@ -66,14 +69,100 @@ typedef struct InvenioPreferences
     /* Keyboard Shortcut */
     GtkWidget       *keyboard_shortcut_enabled;
     GtkWidget       *keyboard_shortcut;
+    gchar           *menu_shortcut;
 } InvenioPreferences;
 
 
+static void
+_save_category_order (InvenioPreferences *preferences)
+{
+    InvenioCategory order[INVENIO_CATEGORIES];
+    GtkTreeIter iter;
+    gboolean valid;
+    guint i = 0;
+
+    valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (preferences->model), &iter);
+
+    while (valid && i < INVENIO_CATEGORIES)
+    {
+        gtk_tree_model_get (GTK_TREE_MODEL (preferences->model), &iter,
+                            INVENIO_PREFERENCES_CATEGORY_COLUMN_CATEGORY, &order[i++], -1);
+        valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (preferences->model), &iter);
+    }
+
+    /* rows are also deleted when the model is torn down, with nothing reordered */
+    if (i == INVENIO_CATEGORIES
+        && memcmp (invenio_configuration_get_snapshot ()->category_order, order, sizeof (order)))
+    {
+        invenio_configuration_set_category_order (order);
+        invenio_remote_set_category_order (order);
+    }
+}
+
+static void
+_category_order_changed (GtkTreeModel   *model,
+                         GtkTreePath    *path,
+                         gpointer        user_data)
+{
+    /* a drag and drop reorder completes by deleting the original row */
+    _save_category_order ((InvenioPreferences *) user_data);
+}
+
+static void
+_apply_menu_shortcut (InvenioPreferences *preferences)
+{
+    const gchar *menu_shortcut = "";
+
+    if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (preferences->keyboard_shortcut_enabled))
+        && preferences->menu_shortcut)
+        menu_shortcut = preferences->menu_shortcut;
+
+    invenio_configuration_set_menu_shortcut (menu_shortcut);
+    invenio_remote_set_menu_shortcut (menu_shortcut);
+}
+
+static void
+_keyboard_shortcut_toggled (GtkToggleButton *toggle_button,
+                            gpointer         user_data)
+{
+    _apply_menu_shortcut ((InvenioPreferences *) user_data);
+}
+
+static void
+_keyboard_shortcut_activate (GtkEntry   *entry,
+                             gpointer    user_data)
+{
+    InvenioPreferences *preferences;
+    GdkModifierType accelerator_mods;
+    guint accelerator_key;
+    gchar *label;
+
+    preferences = (InvenioPreferences *) user_data;
+
+    gtk_accelerator_parse (gtk_entry_get_text (entry), &accelerator_key, &accelerator_mods);
+
+    if (! accelerator_key)
+    {
+        gtk_widget_error_bell (GTK_WIDGET (entry));
+        return;
+    }
+
+    g_free (preferences->menu_shortcut);
+    preferences->menu_shortcut = gtk_accelerator_name (accelerator_key, accelerator_mods);
+
+    label = gtk_accelerator_get_label (accelerator_key, accelerator_mods);
+    gtk_entry_set_text (entry, label);
+    g_free (label);
+
+    _apply_menu_shortcut (preferences);
+}
+
 static gboolean
 _closed (GtkWidget  *widget,
          GdkEvent   *event,
          gpointer    user_data)
 {
+    /* a reorder has already been applied as it happened */
     invenio_configuration_save ();
     gtk_main_quit ();
     return TRUE;
@@ -95,13 +184,20 @@ _category_enabled_toggled (GtkCellRendererToggle    *cell_renderer,
     path = gtk_tree_path_new_from_string (path_str);
     if (gtk_tree_model_get_iter (GTK_TREE_MODEL (preferences->model), &iter, path))
     {
+        InvenioCategory category;
         gboolean active;
         gtk_tree_model_get (GTK_TREE_MODEL (preferences->model), &iter,
-                            INVENIO_PREFERENCES_CATEGORY_COLUMN_ENABLED, &active, -1);
+                            INVENIO_PREFERENCES_CATEGORY_COLUMN_ENABLED, &active,
+                            INVENIO_PREFERENCES_CATEGORY_COLUMN_CATEGORY, &category,
+                            -1);
         gtk_list_store_set (GTK_LIST_STORE (preferences->model), &iter,
                             INVENIO_PREFERENCES_CATEGORY_COLUMN_ENABLED, active ^ TRUE,
                             -1);
+
+        invenio_configuration_set_search_category (category, active ^ TRUE);
+        invenio_remote_set_search_category (category, active ^ TRUE);
     }
+    gtk_tree_path_free (path);
 }
 
 static void
@@ -147,6 +243,7 @@ _category_cell_data (GtkTreeViewColumn  *tree_column,
 static void
 _load (InvenioPreferences *preferences)
 {
+    const InvenioConfigurationSnapshot *configuration;
     const gchar *keybinding;
     gchar *keybinding_label;
     GdkModifierType accelerator_mods;
@@ -154,22 +251,28 @@ _load (InvenioPreferences *preferences)
     guint i, accelerator_key;
     GtkTreeIter iter;
 
-    for (i = 1, category = (InvenioCategory) 0; category < INVENIO_CATEGORIES; category++, i++)
+    configuration = invenio_configuration_get_snapshot ();
+
+    for (i = 1; i <= INVENIO_CATEGORIES; i++)
     {
+        category = configuration->category_order[i - 1];
+
         gtk_list_store_append (GTK_LIST_STORE (preferences->model), &iter);
         gtk_list_store_set (GTK_LIST_STORE (preferences->model), &iter,
                             INVENIO_PREFERENCES_CATEGORY_COLUMN_INDEX, i,
-                            INVENIO_PREFERENCES_CATEGORY_COLUMN_ENABLED, invenio_configuration_get_search_category (category),
+                            INVENIO_PREFERENCES_CATEGORY_COLUMN_ENABLED, configuration->category_enabled[category],
                             INVENIO_PREFERENCES_CATEGORY_COLUMN_ICON, NULL,
                             INVENIO_PREFERENCES_CATEGORY_COLUMN_CATEGORY, category,
                             -1);
     }
 
-    keybinding = invenio_configuration_get_menu_shortcut ();
+    keybinding = configuration->menu_shortcut;
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (preferences->keyboard_shortcut_enabled),
-                                  keybinding ? TRUE : FALSE);
-    if (keybinding)
+                                  keybinding && *keybinding);
+    if (keybinding && *keybinding)
     {
+        preferences->menu_shortcut = g_strdup (keybinding);
+
         gtk_accelerator_parse (keybinding, &accelerator_key, &accelerator_mods);
         keybinding_label = gtk_accelerator_get_label (accelerator_key, accelerator_mods);
         gtk_entry_set_text (GTK_ENTRY (preferences->keyboard_shortcut), keybinding_label);
@@ -272,6 +375,14 @@ invenio_preferences_create (void)
 
     _load (preferences);
 
+    /* changes are pushed to a running invenio as they are made */
+    g_signal_connect (G_OBJECT (preferences->model), "row-deleted",
+                      G_CALLBACK (_category_order_changed), preferences);
+    g_signal_connect (G_OBJECT (preferences->keyboard_shortcut_enabled), "toggled",
+                      G_CALLBACK (_keyboard_shortcut_toggled), preferences);
+    g_signal_connect (G_OBJECT (preferences->keyboard_shortcut), "activate",
+                      G_CALLBACK (_keyboard_shortcut_activate), preferences);
+
     return preferences;
 }
 
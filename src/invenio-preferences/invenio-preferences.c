@@ -32,6 +32,8 @@
 
 #include "invenio-preferences-dialog.h"
 
+#include "libinvenio/invenio-configuration.h"
+
 int
 main (int argc, char **argv)
 {
@@ -44,6 +46,8 @@ main (int argc, char **argv)
 
     gtk_main ();
 
+    invenio_configuration_flush ();
+
     return EXIT_SUCCESS;
 }
 
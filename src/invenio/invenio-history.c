@@ -0,0 +1,728 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include "invenio-history.h"
+
+#include "libinvenio/invenio-configuration.h"
+#include "libinvenio/invenio-fuzzy.h"
+
+#define INVENIO_HISTORY_FILE                    "history"
+
+/* the log is compacted once it holds this many lines per remembered entry */
+#define INVENIO_HISTORY_COMPACTION_RATIO        (2)
+
+
+typedef struct InvenioHistoryEntry
+{
+    InvenioCategory      category;
+    gchar               *title;
+    gchar               *description;
+    gchar               *uri;
+    gchar               *location;
+
+    /* the title as matched, computed on first use */
+    InvenioFuzzyText    *normalized_title;
+
+    /* decayed launch count, as of time (in seconds) */
+    gdouble              score;
+    gint64               time;
+} InvenioHistoryEntry;
+
+/* an entry with its score as of some time, computed once */
+typedef struct InvenioHistoryScore
+{
+    InvenioHistoryEntry *entry;
+    gdouble              score;
+} InvenioHistoryScore;
+
+typedef enum InvenioHistoryOperation
+{
+    INVENIO_HISTORY_OPERATION_APPEND,
+    INVENIO_HISTORY_OPERATION_REWRITE,
+} InvenioHistoryOperation;
+
+typedef struct InvenioHistoryWrite
+{
+    InvenioHistoryOperation  operation;
+    GString                 *data;
+} InvenioHistoryWrite;
+
+typedef struct InvenioHistory
+{
+    gchar           *filename;
+
+    /* entries keyed by uri, or by location for results without one */
+    GHashTable      *entries;
+    guint            lines;
+
+    /* a single writer keeps appends and rewrites in order */
+    GThreadPool     *writer;
+
+    /* launches recorded before the history was loaded, most recent first */
+    GSList          *pending;
+} InvenioHistory;
+
+
+static InvenioHistory history;
+
+
+static const gchar *
+_entry_key (const gchar * const uri,
+            const gchar * const location)
+{
+    return uri ? uri : location;
+}
+
+static void
+_entry_free (InvenioHistoryEntry *entry)
+{
+    g_free (entry->title);
+    g_free (entry->description);
+    g_free (entry->uri);
+    g_free (entry->location);
+    if (entry->normalized_title)
+        invenio_fuzzy_text_free (entry->normalized_title);
+    g_slice_free (InvenioHistoryEntry, entry);
+}
+
+static gdouble
+_decay (const gint64 elapsed)
+{
+    const InvenioConfigurationSnapshot *configuration;
+
+    configuration = invenio_configuration_get_snapshot ();
+
+    return exp2 (- (gdouble) elapsed / (configuration->history_half_life * 24.0 * 60.0 * 60.0));
+}
+
+static gdouble
+_entry_score (const InvenioHistoryEntry * const entry,
+              const gint64                      now)
+{
+    return entry->score * _decay (now - entry->time);
+}
+
+/* folds a weight recorded at time into the entry's decayed score */
+static void
+_entry_add (InvenioHistoryEntry *entry,
+            const gdouble        weight,
+            const gint64         time)
+{
+    if (time >= entry->time)
+    {
+        entry->score = _entry_score (entry, time) + weight;
+        entry->time = time;
+    }
+    else
+    {
+        entry->score += weight * _decay (entry->time - time);
+    }
+}
+
+static gchar *
+_field (const gchar * const value)
+{
+    return (value && *value) ? g_strcompress (value) : NULL;
+}
+
+/*
+ * Each line records a weight at a point in time for a result:
+ *
+ *   time \t weight \t category \t title \t description \t uri \t location
+ *
+ * with the strings escaped with g_strescape.  A launch appends a line with a
+ * weight of one; compaction rewrites the log with one line per entry carrying
+ * its decayed score.
+ */
+static void
+_parse_line (const gchar * const line)
+{
+    InvenioHistoryEntry *entry;
+    InvenioCategory category;
+    gchar **fields, *uri, *location;
+    const gchar *key;
+    gdouble weight;
+    gint64 time;
+
+    fields = g_strsplit (line, "\t", 7);
+
+    if (g_strv_length (fields) != 7)
+        goto out;
+
+    time = g_ascii_strtoll (fields[0], NULL, 10);
+    weight = g_ascii_strtod (fields[1], NULL);
+    category = invenio_category_from_string (fields[2]);
+
+    uri = _field (fields[5]);
+    location = _field (fields[6]);
+    key = _entry_key (uri, location);
+
+    if (category == INVENIO_CATEGORIES || ! key || weight <= 0.0)
+    {
+        g_free (uri);
+        g_free (location);
+        goto out;
+    }
+
+    entry = g_hash_table_lookup (history.entries, key);
+
+    if (! entry)
+    {
+        entry = g_slice_new0 (InvenioHistoryEntry);
+        entry->time = time;
+        entry->uri = uri;
+        entry->location = location;
+        g_hash_table_insert (history.entries, (gpointer) _entry_key (entry->uri, entry->location), entry);
+    }
+    else
+    {
+        g_free (uri);
+        g_free (location);
+    }
+
+    /* the most recent line carries the current title and description */
+    if (time >= entry->time || ! entry->title)
+    {
+        g_free (entry->title);
+        g_free (entry->description);
+        if (entry->normalized_title)
+            invenio_fuzzy_text_free (entry->normalized_title);
+
+        entry->category = category;
+        entry->title = _field (fields[3]);
+        entry->normalized_title = NULL;
+        entry->description = _field (fields[4]);
+    }
+
+    _entry_add (entry, weight, time);
+
+out:
+    g_strfreev (fields);
+}
+
+static void
+_append_line (GString                           *data,
+              const InvenioHistoryEntry * const  entry,
+              const gdouble                      weight,
+              const gint64                       time)
+{
+    gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+    gchar *title, *description, *uri, *location;
+
+    title = g_strescape (entry->title ? entry->title : "", NULL);
+    description = g_strescape (entry->description ? entry->description : "", NULL);
+    uri = g_strescape (entry->uri ? entry->uri : "", NULL);
+    location = g_strescape (entry->location ? entry->location : "", NULL);
+
+    g_string_append_printf (data, "%" G_GINT64_FORMAT "\t%s\t%s\t%s\t%s\t%s\t%s\n",
+                            time,
+                            g_ascii_dtostr (buffer, sizeof (buffer), weight),
+                            invenio_category_to_string (entry->category),
+                            title, description, uri, location);
+
+    g_free (title);
+    g_free (description);
+    g_free (uri);
+    g_free (location);
+}
+
+static void
+_write (gpointer data,
+        gpointer user_data)
+{
+    InvenioHistoryWrite *write;
+    GFileOutputStream *stream;
+    GError *error = NULL;
+    GFile *file;
+
+    write = (InvenioHistoryWrite *) data;
+
+    switch (write->operation)
+    {
+        case INVENIO_HISTORY_OPERATION_APPEND:
+            file = g_file_new_for_path (history.filename);
+            stream = g_file_append_to (file, G_FILE_CREATE_PRIVATE, NULL, &error);
+
+            if (stream)
+            {
+                g_output_stream_write_all (G_OUTPUT_STREAM (stream),
+                                           write->data->str, write->data->len,
+                                           NULL, NULL, &error);
+                g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, error ? NULL : &error);
+                g_object_unref (stream);
+            }
+
+            g_object_unref (file);
+            break;
+
+        case INVENIO_HISTORY_OPERATION_REWRITE:
+            g_file_set_contents (history.filename, write->data->str, write->data->len, &error);
+            break;
+    }
+
+    if (error)
+    {
+        g_warning ("Unable to write history: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_string_free (write->data, TRUE);
+    g_slice_free (InvenioHistoryWrite, write);
+}
+
+static void
+_queue_write (const InvenioHistoryOperation  operation,
+              GString                       *data)
+{
+    InvenioHistoryWrite *write;
+
+    write = g_slice_new (InvenioHistoryWrite);
+    write->operation = operation;
+    write->data = data;
+
+    g_thread_pool_push (history.writer, write, NULL);
+}
+
+static gint
+_compare_score (gconstpointer a,
+                gconstpointer b)
+{
+    const InvenioHistoryScore * const lhs = a;
+    const InvenioHistoryScore * const rhs = b;
+
+    return (lhs->score < rhs->score) - (lhs->score > rhs->score);
+}
+
+static void
+_heap_sift_up (InvenioHistoryScore *heap,
+               guint                index)
+{
+    InvenioHistoryScore score;
+    guint parent;
+
+    score = heap[index];
+
+    for (; index > 0 && heap[parent = (index - 1) / 2].score > score.score; index = parent)
+        heap[index] = heap[parent];
+
+    heap[index] = score;
+}
+
+static void
+_heap_sift_down (InvenioHistoryScore   *heap,
+                 const guint            length,
+                 guint                  index)
+{
+    InvenioHistoryScore score;
+    guint child;
+
+    score = heap[index];
+
+    for (; (child = 2 * index + 1) < length; index = child)
+    {
+        if (child + 1 < length && heap[child + 1].score < heap[child].score)
+            child++;
+
+        if (score.score <= heap[child].score)
+            break;
+
+        heap[index] = heap[child];
+    }
+
+    heap[index] = score;
+}
+
+/*
+ * The (at most) limit highest scoring entries as of now, highest first, of
+ * the category (any, for INVENIO_CATEGORIES) whose title matches the pattern
+ * (any, for NULL).  Entries are filtered by category before being scored,
+ * each is scored once, and only those which would make the cut are matched,
+ * the best so far being kept in a min-heap.
+ */
+static InvenioHistoryScore *
+_top_entries (const InvenioCategory             category,
+              const InvenioFuzzyPattern * const pattern,
+              const guint                       limit,
+              const gint64                      now,
+              guint                            *length)
+{
+    InvenioHistoryScore *heap;
+    InvenioHistoryEntry *entry;
+    GHashTableIter iter;
+    gpointer value;
+    gdouble score;
+    guint count = 0;
+
+    *length = 0;
+
+    if (! limit)
+        return NULL;
+
+    heap = g_new (InvenioHistoryScore, limit);
+
+    g_hash_table_iter_init (&iter, history.entries);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        entry = value;
+
+        if (category != INVENIO_CATEGORIES && entry->category != category)
+            continue;
+
+        score = _entry_score (entry, now);
+
+        if (count == limit && score <= heap[0].score)
+            continue;
+
+        if (pattern)
+        {
+            if (! entry->normalized_title && entry->title)
+                entry->normalized_title = invenio_fuzzy_text_new (entry->title);
+
+            /* the keywords need only be a subsequence of the title */
+            if (! invenio_fuzzy_pattern_match (pattern, entry->normalized_title, NULL))
+                continue;
+        }
+
+        if (count < limit)
+        {
+            heap[count].entry = entry;
+            heap[count].score = score;
+            _heap_sift_up (heap, count++);
+        }
+        else
+        {
+            heap[0].entry = entry;
+            heap[0].score = score;
+            _heap_sift_down (heap, count, 0);
+        }
+    }
+
+    qsort (heap, count, sizeof (*heap), _compare_score);
+
+    *length = count;
+    return heap;
+}
+
+static void
+_compact (void)
+{
+    const InvenioConfigurationSnapshot *configuration;
+    InvenioHistoryScore *entries;
+    InvenioHistoryEntry *entry;
+    GString *data;
+    gint64 now;
+    guint i, length;
+
+    configuration = invenio_configuration_get_snapshot ();
+    now = g_get_real_time () / G_USEC_PER_SEC;
+
+    entries = _top_entries (INVENIO_CATEGORIES, NULL, g_hash_table_size (history.entries),
+                            now, &length);
+    data = g_string_sized_new (length * 128);
+
+    /* keep the highest scoring entries, forget the rest */
+    for (i = 0; i < length; i++)
+    {
+        entry = entries[i].entry;
+
+        if (i < configuration->history_size)
+            _append_line (data, entry, entry->score, entry->time);
+        else
+            g_hash_table_remove (history.entries, _entry_key (entry->uri, entry->location));
+    }
+
+    g_free (entries);
+
+    history.lines = g_hash_table_size (history.entries);
+    _queue_write (INVENIO_HISTORY_OPERATION_REWRITE, data);
+}
+
+static void
+_maybe_compact (void)
+{
+    const InvenioConfigurationSnapshot *configuration;
+
+    configuration = invenio_configuration_get_snapshot ();
+
+    if (history.lines > INVENIO_HISTORY_COMPACTION_RATIO * MAX (configuration->history_size,
+                                                                g_hash_table_size (history.entries)))
+        _compact ();
+}
+
+static void
+_load (void)
+{
+    const gchar *contents, *line, *end, *newline;
+    GMappedFile *mapped;
+    GError *error = NULL;
+    gchar *directory;
+
+    directory = g_build_filename (g_get_user_data_dir (), "invenio", NULL);
+    if (g_mkdir_with_parents (directory, 0700) == -1)
+        g_warning ("Could not create history directory");
+
+    history.filename = g_build_filename (directory, INVENIO_HISTORY_FILE, NULL);
+    history.entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             NULL, (GDestroyNotify) _entry_free);
+    history.writer = g_thread_pool_new (_write, NULL, 1, FALSE, NULL);
+
+    g_free (directory);
+
+    mapped = g_mapped_file_new (history.filename, FALSE, &error);
+
+    if (error)
+    {
+        if (! g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_warning ("Unable to read history: %s", error->message);
+        g_error_free (error);
+        return;
+    }
+
+    contents = g_mapped_file_get_contents (mapped);
+    end = contents + g_mapped_file_get_length (mapped);
+
+    /* the mapping is not nul terminated, so split it up by hand */
+    for (line = contents; line && line < end; line = newline ? newline + 1 : NULL)
+    {
+        gchar *copy;
+
+        newline = memchr (line, '\n', end - line);
+
+        copy = g_strndup (line, (newline ? newline : end) - line);
+        _parse_line (copy);
+        g_free (copy);
+
+        history.lines++;
+    }
+
+    g_mapped_file_unref (mapped);
+
+    _maybe_compact ();
+}
+
+/* records the launches made while the history was loading */
+static void
+_record_pending (void)
+{
+    InvenioHistoryEntry *entry;
+    GSList *pending;
+
+    pending = g_slist_reverse (history.pending);
+    history.pending = NULL;
+
+    for (; pending; pending = g_slist_delete_link (pending, pending))
+    {
+        entry = pending->data;
+
+        invenio_history_record (entry->category, entry->title, entry->description,
+                                entry->uri, entry->location);
+
+        _entry_free (entry);
+    }
+}
+
+void
+invenio_history_load (void)
+{
+    if (history.entries)
+        return;
+
+    _load ();
+    _record_pending ();
+}
+
+void
+invenio_history_flush (void)
+{
+    /* nothing is lost if invenio quits before the history is loaded */
+    if (history.pending)
+        invenio_history_load ();
+
+    if (! history.writer)
+        return;
+
+    /* wait for the queued writes */
+    g_thread_pool_free (history.writer, FALSE, TRUE);
+    history.writer = g_thread_pool_new (_write, NULL, 1, FALSE, NULL);
+}
+
+void
+invenio_history_record (const InvenioCategory  category,
+                        const gchar * const    title,
+                        const gchar * const    description,
+                        const gchar * const    uri,
+                        const gchar * const    location)
+{
+    InvenioHistoryEntry *entry;
+    const gchar *key;
+    GString *data;
+    gint64 now;
+
+    key = _entry_key (uri, location);
+    if (! key)
+        return;
+
+    /* a launch before the history has loaded is recorded once it has */
+    if (! history.entries)
+    {
+        entry = g_slice_new0 (InvenioHistoryEntry);
+        entry->category = category;
+        entry->title = g_strdup (title);
+        entry->description = g_strdup (description);
+        entry->uri = g_strdup (uri);
+        entry->location = g_strdup (location);
+
+        history.pending = g_slist_prepend (history.pending, entry);
+        return;
+    }
+
+    now = g_get_real_time () / G_USEC_PER_SEC;
+
+    entry = g_hash_table_lookup (history.entries, key);
+
+    if (! entry)
+    {
+        entry = g_slice_new0 (InvenioHistoryEntry);
+        entry->time = now;
+        entry->uri = g_strdup (uri);
+        entry->location = g_strdup (location);
+        g_hash_table_insert (history.entries, (gpointer) _entry_key (entry->uri, entry->location), entry);
+    }
+
+    g_free (entry->title);
+    g_free (entry->description);
+    if (entry->normalized_title)
+        invenio_fuzzy_text_free (entry->normalized_title);
+
+    entry->category = category;
+    entry->title = g_strdup (title);
+    entry->normalized_title = NULL;
+    entry->description = g_strdup (description);
+
+    _entry_add (entry, 1.0, now);
+
+    data = g_string_new (NULL);
+    _append_line (data, entry, 1.0, now);
+    _queue_write (INVENIO_HISTORY_OPERATION_APPEND, data);
+
+    history.lines++;
+    _maybe_compact ();
+}
+
+gdouble
+invenio_history_get_score (const InvenioQueryResult * const result)
+{
+    const InvenioHistoryEntry *entry;
+    const gchar *key;
+
+    if (! history.entries)
+        return 0.0;
+
+    key = _entry_key (invenio_query_result_get_uri (result),
+                      invenio_query_result_get_location (result));
+
+    if (! key || ! (entry = g_hash_table_lookup (history.entries, key)))
+        return 0.0;
+
+    return _entry_score (entry, g_get_real_time () / G_USEC_PER_SEC);
+}
+
+GSList *
+invenio_history_lookup (const gchar * const    keywords,
+                        const InvenioCategory  category,
+                        const guint            limit)
+{
+    InvenioHistoryScore *entries;
+    InvenioHistoryEntry *entry;
+    InvenioFuzzyPattern *pattern;
+    GSList *results = NULL;
+    guint i, length;
+
+    if (! history.entries || ! g_hash_table_size (history.entries))
+        return NULL;
+
+    pattern = invenio_fuzzy_pattern_new (keywords);
+
+    entries = _top_entries (category, pattern, limit, g_get_real_time () / G_USEC_PER_SEC, &length);
+
+    for (i = length; i > 0; i--)
+    {
+        entry = entries[i - 1].entry;
+
+        results = g_slist_prepend (results,
+                                   invenio_query_result_new (entry->title,
+                                                             entry->description,
+                                                             entry->uri,
+                                                             entry->location));
+    }
+
+    g_free (entries);
+    invenio_fuzzy_pattern_free (pattern);
+
+    return results;
+}
+
+/* the overall top entries, split up by category but each in score order */
+void
+invenio_history_get_top (const guint    limit,
+                         GSList        *results[INVENIO_CATEGORIES])
+{
+    InvenioHistoryScore *entries;
+    InvenioHistoryEntry *entry;
+    guint i, length;
+
+    memset (results, 0, INVENIO_CATEGORIES * sizeof (*results));
+
+    if (! history.entries || ! limit)
+        return;
+
+    entries = _top_entries (INVENIO_CATEGORIES, NULL, limit,
+                            g_get_real_time () / G_USEC_PER_SEC, &length);
+
+    for (i = length; i > 0; i--)
+    {
+        entry = entries[i - 1].entry;
+
+        results[entry->category] =
+            g_slist_prepend (results[entry->category],
+                             invenio_query_result_new (entry->title,
+                                                       entry->description,
+                                                       entry->uri,
+                                                       entry->location));
+    }
+
+    g_free (entries);
+}
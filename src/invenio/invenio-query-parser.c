@@ -0,0 +1,395 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#include <string.h>
+
+#include "invenio-query-parser.h"
+
+/* categories whose results are files, to which an extension can apply */
+#define INVENIO_QUERY_FILE_CATEGORIES           ((1 << INVENIO_CATEGORY_DOCUMENT) | \
+                                                 (1 << INVENIO_CATEGORY_FONT)     | \
+                                                 (1 << INVENIO_CATEGORY_IMAGE)    | \
+                                                 (1 << INVENIO_CATEGORY_MUSIC)    | \
+                                                 (1 << INVENIO_CATEGORY_VIDEO))
+
+#define INVENIO_QUERY_ALL_CATEGORIES            ((1 << INVENIO_CATEGORIES) - 1)
+
+#define INVENIO_QUERY_EXTENSION_PREFIX          "ext"
+
+
+typedef struct InvenioQueryPrefix
+{
+    const gchar     *prefix;
+    InvenioCategory  category;
+} InvenioQueryPrefix;
+
+/* filter prefixes, in addition to the category names themselves */
+static const InvenioQueryPrefix InvenioQueryPrefixes[] =
+{
+    { "app",    INVENIO_CATEGORY_APPLICATION },
+    { "doc",    INVENIO_CATEGORY_DOCUMENT    },
+    { "dir",    INVENIO_CATEGORY_FOLDER      },
+    { "img",    INVENIO_CATEGORY_IMAGE       },
+    { "mail",   INVENIO_CATEGORY_MESSAGE     },
+    { "song",   INVENIO_CATEGORY_MUSIC       },
+};
+
+
+static InvenioQueryNode *
+_node_new (const InvenioQueryNodeType   type,
+           gchar                       *value,
+           const InvenioCategory        category)
+{
+    InvenioQueryNode *node;
+
+    node = g_slice_new (InvenioQueryNode);
+    node->type = type;
+    node->value = value;
+    node->category = category;
+
+    return node;
+}
+
+static void
+_node_free (InvenioQueryNode *node)
+{
+    g_free (node->value);
+    g_slice_free (InvenioQueryNode, node);
+}
+
+static InvenioCategory
+_lookup_prefix (const gchar * const prefix)
+{
+    InvenioCategory category;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (InvenioQueryPrefixes); i++)
+        if (g_ascii_strcasecmp (InvenioQueryPrefixes[i].prefix, prefix) == 0)
+            return InvenioQueryPrefixes[i].category;
+
+    for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+        if (g_ascii_strcasecmp (invenio_category_to_string (category), prefix) == 0)
+            return category;
+
+    return INVENIO_CATEGORIES;
+}
+
+/* adds the extensions of a (comma separated) list, without any leading dot */
+static void
+_parse_extensions (InvenioQueryAst      *ast,
+                   const gchar * const   list)
+{
+    gchar **extensions, **extension;
+    const gchar *value;
+
+    extensions = g_strsplit (list, ",", -1);
+
+    for (extension = extensions; *extension; extension++)
+    {
+        for (value = *extension; *value == '.'; value++)
+            ;
+
+        if (*value)
+            g_ptr_array_add (ast->nodes,
+                             _node_new (INVENIO_QUERY_NODE_EXTENSION,
+                                        g_ascii_strdown (value, -1),
+                                        INVENIO_CATEGORIES));
+    }
+
+    g_strfreev (extensions);
+}
+
+static void
+_parse_word (InvenioQueryAst    *ast,
+             const gchar        *word)
+{
+    InvenioCategory category;
+    const gchar *colon;
+    gchar *prefix;
+
+    /* prefix:value narrows the search, anything else is a term */
+    if ((colon = strchr (word, ':')) && colon != word)
+    {
+        prefix = g_strndup (word, colon - word);
+        category = _lookup_prefix (prefix);
+
+        if (g_ascii_strcasecmp (prefix, INVENIO_QUERY_EXTENSION_PREFIX) == 0)
+        {
+            _parse_extensions (ast, colon + 1);
+            g_free (prefix);
+            return;
+        }
+
+        g_free (prefix);
+
+        if (category != INVENIO_CATEGORIES)
+        {
+            g_ptr_array_add (ast->nodes,
+                             _node_new (INVENIO_QUERY_NODE_CATEGORY, NULL, category));
+
+            /* app:fire is app: fire */
+            if (*(word = colon + 1) == '\0')
+                return;
+        }
+    }
+
+    g_ptr_array_add (ast->nodes, _node_new (INVENIO_QUERY_NODE_TERM, g_strdup (word), INVENIO_CATEGORIES));
+}
+
+/*
+ * The query language is a list of whitespace separated items, all of which
+ * must match:
+ *
+ *   term           a word which a property starts with
+ *   "some phrase"  words which appear in this order
+ *   app:, doc:     only search the named category (or categories)
+ *   ext:pdf,odt    only files with one of the extensions
+ *
+ * A category prefix may be directly followed by a term, as in app:fire.  An
+ * unterminated phrase extends to the end of the text.  Filters only narrow a
+ * search, so there must be at least one term or phrase.
+ */
+InvenioQueryAst *
+invenio_query_parse (const gchar * const text)
+{
+    InvenioQueryAst *ast;
+    const gchar *start, *end;
+    gchar *word;
+
+    ast = g_slice_new (InvenioQueryAst);
+    ast->nodes = g_ptr_array_new_with_free_func ((GDestroyNotify) _node_free);
+
+    for (start = text; *start; start = end)
+    {
+        if (g_ascii_isspace (*start))
+        {
+            end = start + 1;
+            continue;
+        }
+
+        if (*start == '"')
+        {
+            if (! (end = strchr (++start, '"')))
+                end = start + strlen (start);
+
+            if (end != start)
+                g_ptr_array_add (ast->nodes,
+                                 _node_new (INVENIO_QUERY_NODE_PHRASE,
+                                            g_strndup (start, end - start),
+                                            INVENIO_CATEGORIES));
+
+            if (*end)
+                end++;
+            continue;
+        }
+
+        for (end = start; *end && ! g_ascii_isspace (*end) && *end != '"'; end++)
+            ;
+
+        word = g_strndup (start, end - start);
+        _parse_word (ast, word);
+        g_free (word);
+    }
+
+    return ast;
+}
+
+void
+invenio_query_ast_free (InvenioQueryAst *ast)
+{
+    g_ptr_array_free (ast->nodes, TRUE);
+    g_slice_free (InvenioQueryAst, ast);
+}
+
+/* the categories which need be searched, as a mask */
+guint
+invenio_query_ast_get_categories (const InvenioQueryAst * const ast)
+{
+    const InvenioQueryNode *node;
+    guint categories = 0, i;
+    gboolean extensions = FALSE;
+
+    for (i = 0; i < ast->nodes->len; i++)
+    {
+        node = g_ptr_array_index (ast->nodes, i);
+
+        if (node->type == INVENIO_QUERY_NODE_CATEGORY)
+            categories |= (1 << node->category);
+        else if (node->type == INVENIO_QUERY_NODE_EXTENSION)
+            extensions = TRUE;
+    }
+
+    if (! categories)
+        categories = INVENIO_QUERY_ALL_CATEGORIES;
+
+    if (extensions)
+        categories &= INVENIO_QUERY_FILE_CATEGORIES;
+
+    return categories;
+}
+
+/* the terms and phrases, for matching against results locally */
+gchar *
+invenio_query_ast_get_text (const InvenioQueryAst * const ast)
+{
+    const InvenioQueryNode *node;
+    GString *text;
+    guint i;
+
+    text = g_string_new (NULL);
+
+    for (i = 0; i < ast->nodes->len; i++)
+    {
+        node = g_ptr_array_index (ast->nodes, i);
+
+        if (node->type != INVENIO_QUERY_NODE_TERM && node->type != INVENIO_QUERY_NODE_PHRASE)
+            continue;
+
+        if (text->len)
+            g_string_append_c (text, ' ');
+        g_string_append (text, node->value);
+    }
+
+    return g_string_free (text, FALSE);
+}
+
+/*
+ * Appends the words of value, each followed by suffix and separated by
+ * separator.  Only letters and digits make it through, which leaves nothing for
+ * the full text search or a regular expression to interpret as an operator, and
+ * nothing which needs escaping in a SPARQL string.
+ */
+static guint
+_append_words (GString              *output,
+               const gchar * const   value,
+               const gchar * const   separator,
+               const gchar * const   suffix)
+{
+    const gchar *character;
+    gboolean in_word = FALSE;
+    guint words = 0;
+    gunichar c;
+
+    for (character = value; *character; character = g_utf8_next_char (character))
+    {
+        c = g_utf8_get_char (character);
+
+        if (g_unichar_isalnum (c))
+        {
+            if (! in_word && words++)
+                g_string_append (output, separator);
+
+            g_string_append_unichar (output, c);
+            in_word = TRUE;
+        }
+        else if (in_word)
+        {
+            g_string_append (output, suffix);
+            in_word = FALSE;
+        }
+    }
+
+    if (in_word)
+        g_string_append (output, suffix);
+
+    return words;
+}
+
+/*
+ * Compiles the query into the parts of the SPARQL templates: the contents of
+ * the fts:match string, and a FILTER for the extensions (or an empty string).
+ * Terms match as prefixes, phrases match exactly.  Returns FALSE when there is
+ * nothing to search for.
+ */
+gboolean
+invenio_query_ast_to_sparql (const InvenioQueryAst * const ast,
+                             gchar                       **match,
+                             gchar                       **filter)
+{
+    GString *terms, *extensions, *words;
+    const InvenioQueryNode *node;
+    guint i;
+
+    terms = g_string_new (NULL);
+    extensions = g_string_new (NULL);
+    words = g_string_new (NULL);
+
+    for (i = 0; i < ast->nodes->len; i++)
+    {
+        node = g_ptr_array_index (ast->nodes, i);
+        g_string_truncate (words, 0);
+
+        switch (node->type)
+        {
+            case INVENIO_QUERY_NODE_TERM:
+                if (_append_words (words, node->value, " ", "*"))
+                    g_string_append_printf (terms, "%s%s",
+                                            terms->len ? " " : "", words->str);
+                break;
+
+            case INVENIO_QUERY_NODE_PHRASE:
+                /* the quotes are escaped within the SPARQL string */
+                if (_append_words (words, node->value, " ", ""))
+                    g_string_append_printf (terms, "%s\\\"%s\\\"",
+                                            terms->len ? " " : "", words->str);
+                break;
+
+            case INVENIO_QUERY_NODE_EXTENSION:
+                /* tar.gz is matched as tar\.gz */
+                if (_append_words (words, node->value, "\\\\.", ""))
+                    g_string_append_printf (extensions, "%s%s",
+                                            extensions->len ? "|" : "", words->str);
+                break;
+
+            case INVENIO_QUERY_NODE_CATEGORY:
+                break;
+        }
+    }
+
+    g_string_free (words, TRUE);
+
+    if (! terms->len)
+    {
+        g_string_free (terms, TRUE);
+        g_string_free (extensions, TRUE);
+        return FALSE;
+    }
+
+    if (extensions->len)
+        *filter = g_strdup_printf ("FILTER (REGEX (?location, \"\\\\.(%s)$\", \"i\"))",
+                                   extensions->str);
+    else
+        *filter = g_strdup ("");
+
+    *match = g_string_free (terms, FALSE);
+    g_string_free (extensions, TRUE);
+
+    return TRUE;
+}
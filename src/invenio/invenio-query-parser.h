@@ -0,0 +1,77 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#ifndef __INVENIO_QUERY_PARSER_H__
+#define __INVENIO_QUERY_PARSER_H__
+
+#include <glib.h>
+
+#include "libinvenio/invenio-category.h"
+
+typedef enum InvenioQueryNodeType
+{
+    INVENIO_QUERY_NODE_TERM,
+    INVENIO_QUERY_NODE_PHRASE,
+    INVENIO_QUERY_NODE_CATEGORY,
+    INVENIO_QUERY_NODE_EXTENSION,
+} InvenioQueryNodeType;
+
+typedef struct InvenioQueryNode
+{
+    InvenioQueryNodeType     type;
+    gchar                   *value;
+    InvenioCategory          category;
+} InvenioQueryNode;
+
+typedef struct InvenioQueryAst
+{
+    /* all of the nodes must match */
+    GPtrArray               *nodes;
+} InvenioQueryAst;
+
+InvenioQueryAst *
+invenio_query_parse (const gchar * const text);
+
+void
+invenio_query_ast_free (InvenioQueryAst *ast);
+
+guint
+invenio_query_ast_get_categories (const InvenioQueryAst * const ast);
+
+gchar *
+invenio_query_ast_get_text (const InvenioQueryAst * const ast);
+
+gboolean
+invenio_query_ast_to_sparql (const InvenioQueryAst * const ast,
+                             gchar                       **match,
+                             gchar                       **filter);
+
+#endif
+
@@ -32,12 +32,17 @@
 
 #include "invenio-query-result.h"
 
+#include "libinvenio/invenio-fuzzy.h"
+
 struct InvenioQueryResult
 {
     gchar *title;
     gchar *description;
     gchar *uri;
     gchar *location;
+
+    /* computed on first use */
+    InvenioFuzzyText *normalized_title;
 };
 
 InvenioQueryResult *
@@ -52,16 +57,16 @@ invenio_query_result_new (const gchar * const title,
 
     /* XXX Is there a more robust way to check for undefined values? */
 
-    if (strcmp (title, "title_u") != 0)
+    if (title && strcmp (title, "title_u") != 0)
         result->title = g_strdup (title);
 
-    if (strcmp (description, "description_u") != 0)
+    if (description && strcmp (description, "description_u") != 0)
         result->description = g_strdup (description);
 
-    if (strcmp (uri, "uri_u") != 0)
+    if (uri && strcmp (uri, "uri_u") != 0)
         result->uri = g_strdup (uri);
 
-    if (strcmp (location, "location_u") != 0)
+    if (location && strcmp (location, "location_u") != 0)
         result->location = g_strdup (location);
 
     return result;
@@ -82,6 +87,9 @@ invenio_query_result_free (InvenioQueryResult *result)
     if (result->location)
         g_free (result->location);
 
+    if (result->normalized_title)
+        invenio_fuzzy_text_free (result->normalized_title);
+
     g_slice_free (InvenioQueryResult, result);
 }
 
@@ -110,3 +118,16 @@ invenio_query_result_get_location (const InvenioQueryResult * const result)
     return result->location;
 }
 
+/*
+ * The title as normalized for matching.  Results are matched against every
+ * refinement of the search, so this is done once and kept with the result.
+ */
+const InvenioFuzzyText *
+invenio_query_result_get_normalized_title (InvenioQueryResult *result)
+{
+    if (! result->normalized_title && result->title)
+        result->normalized_title = invenio_fuzzy_text_new (result->title);
+
+    return result->normalized_title;
+}
+
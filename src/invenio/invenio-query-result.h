@@ -33,6 +33,8 @@
 
 #include <glib.h>
 
+#include "libinvenio/invenio-fuzzy.h"
+
 typedef struct InvenioQueryResult InvenioQueryResult;
 
 InvenioQueryResult *
@@ -57,5 +59,8 @@ invenio_query_result_get_uri (const InvenioQueryResult * const result);
 const gchar *
 invenio_query_result_get_location (const InvenioQueryResult * const result);
 
+const InvenioFuzzyText *
+invenio_query_result_get_normalized_title (InvenioQueryResult *result);
+
 #endif
 
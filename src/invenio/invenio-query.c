@@ -28,54 +28,110 @@
  * OF SUCH DAMAGE.
  **/
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <glib.h>
+#include <gio/gio.h>
 #include <libtracker-client/tracker-client.h>
 
 #include "invenio-query.h"
+#include "invenio-history.h"
+#include "invenio-query-parser.h"
 #include "invenio-query-result.h"
 
 #include "libinvenio/invenio-configuration.h"
+#include "libinvenio/invenio-fuzzy.h"
+
 
+/* rows requested per page, as a multiple of the displayed limit */
+#define INVENIO_QUERY_OVERFETCH     2
 
-#define RESULTS_PER_CATEGORY        4
 
+typedef struct InvenioQueryRequest
+{
+    InvenioQuery            *query;
+    InvenioCategory          category;
+    guint                    count;
+} InvenioQueryRequest;
 
 typedef struct InvenioTrackerQuery
 {
-    gchar                   *query;
     guint                    id;
     gboolean                 valid;
 
+    InvenioQueryRequest     *request;
+    guint                    timeout_id;
+
     GSList                  *results;
+
+    /* the results are from the history, until tracker has answered */
+    gboolean                 provisional;
+
+    /* rows fetched ahead of being displayed, and the paging state */
+    GSList                  *spare;
+    guint                    fetched;
+    guint                    wanted;
+    gboolean                 exhausted;
 } InvenioTrackerQuery;
 
 struct InvenioQuery
 {
+    /* the terms of the search, and the search compiled for the templates */
+    gchar                   *keywords;
+    gchar                   *match;
+    gchar                   *filter;
+    guint                    categories;
+
+    InvenioFuzzyPattern     *pattern;
     InvenioTrackerQuery      queries[INVENIO_CATEGORIES];
 
+    /* the category holding each result, by normalized uri, and their rank */
+    GHashTable              *owners;
+    guint                    precedence[INVENIO_CATEGORIES];
+
     InvenioQueryCompleted    callback;
     gpointer                 user_data;
-
-    GError                  *error;
 };
 
-typedef struct InvenioQueryRequest
+
+typedef struct InvenioQueryOwner
 {
-    InvenioQuery            *query;
     InvenioCategory          category;
-} InvenioQueryRequest;
+    InvenioQueryResult      *result;
+} InvenioQueryOwner;
+
+typedef struct InvenioQueryRankedResult
+{
+    InvenioQueryResult      *result;
+    guint                    position;
+
+    gdouble                  history;
+    gboolean                 matched;
+    gdouble                  match;
+} InvenioQueryRankedResult;
+
+
+typedef struct InvenioQueryWarmUp
+{
+    guint                    outstanding;
+    gint64                   start;
+
+    InvenioQueryWarmedUp     callback;
+    gpointer                 user_data;
+} InvenioQueryWarmUp;
 
 
 static TrackerClient *client;
 
 #define SPARQL_QUERY_HEADER "SELECT ?title ?description ?uri ?location WHERE { "
-#define SPARQL_QUERY_FOOTER " } ORDER BY DESC (fts:rank (?urn)) OFFSET 0 LIMIT " G_STRINGIFY (RESULTS_PER_CATEGORY)
+#define SPARQL_QUERY_FOOTER " %s } ORDER BY DESC (fts:rank (?urn)) OFFSET %u LIMIT %u"
 
 static const gchar *queries[INVENIO_CATEGORIES] =
 {
     [INVENIO_CATEGORY_APPLICATION]  =   SPARQL_QUERY_HEADER
                                         " ?urn a nfo:Software ."
-                                        " ?urn fts:match \"%s*\" ."
+                                        " ?urn fts:match \"%s\" ."
                                         " ?urn nie:title ?title ;"
                                         "      nfo:softwareCmdLine ?uri ;"
                                         "      nie:url ?location ."
@@ -84,7 +140,7 @@ static const gchar *queries[INVENIO_CATEGORIES] =
 
     [INVENIO_CATEGORY_BOOKMARK]     =   SPARQL_QUERY_HEADER
                                         " ?urn a nfo:Bookmark ."
-                                        " ?urn fts:match \"%s*\" ."
+                                        " ?urn fts:match \"%s\" ."
                                         " ?urn nie:title ?title ;"
                                         "      nie:links ?description ;"
                                         "      nie:links ?uri ;"
@@ -93,7 +149,7 @@ static const gchar *queries[INVENIO_CATEGORIES] =
 
     [INVENIO_CATEGORY_CONTACT]      =   SPARQL_QUERY_HEADER
                                         " ?urn a nco:Contact ."
-                                        " ?urn fts:match \"%s*\" ."
+                                        " ?urn fts:match \"%s\" ."
                                         " ?urn nco:fullname ?title ;"
                                         "      nco:fullname ?description ;"
                                         "      nie:url ?location ."
@@ -102,7 +158,7 @@ static const gchar *queries[INVENIO_CATEGORIES] =
 
     [INVENIO_CATEGORY_DOCUMENT]     =   SPARQL_QUERY_HEADER
                                         " ?urn a nfo:Document ."
-                                        " ?urn fts:match \"%s*\" ."
+                                        " ?urn fts:match \"%s\" ."
                                         " ?urn nfo:fileName ?title ;"
                                         "      nfo:fileName ?description ;"
                                         "      nie:url ?uri ;"
@@ -111,7 +167,7 @@ static const gchar *queries[INVENIO_CATEGORIES] =
 
     [INVENIO_CATEGORY_FOLDER]       =   SPARQL_QUERY_HEADER
                                         " ?urn a nfo:Folder ."
-                                        " ?urn fts:match \"%s*\" ."
+                                        " ?urn fts:match \"%s\" ."
                                         " ?urn nfo:fileName ?title ;"
                                         "      nfo:fileName ?description ;"
                                         "      nie:url ?uri ;"
@@ -120,7 +176,7 @@ static const gchar *queries[INVENIO_CATEGORIES] =
 
     [INVENIO_CATEGORY_FONT]         =   SPARQL_QUERY_HEADER
                                         " ?urn a nfo:Font ."
-                                        " ?urn fts:match \"%s*\" ."
+                                        " ?urn fts:match \"%s\" ."
                                         " ?urn nfo:fontFamily ?title ;"
                                         "      nfo:fontFamily ?description ;"
                                         "      nie:url ?uri ;"
@@ -129,7 +185,7 @@ static const gchar *queries[INVENIO_CATEGORIES] =
 
     [INVENIO_CATEGORY_IMAGE]        =   SPARQL_QUERY_HEADER
                                         " ?urn a nfo:Image ."
-                                        " ?urn fts:match \"%s*\" ."
+                                        " ?urn fts:match \"%s\" ."
                                         " ?urn nfo:fileName ?title ;"
                                         "      nfo:fileName ?description ;"
                                         "      nie:url ?uri ;"
@@ -138,7 +194,7 @@ static const gchar *queries[INVENIO_CATEGORIES] =
 
     [INVENIO_CATEGORY_MESSAGE]      =   SPARQL_QUERY_HEADER
                                         " ?urn a nmo:Message ."
-                                        " ?urn fts:match \"%s*\" ."
+                                        " ?urn fts:match \"%s\" ."
                                         " ?urn nmo:messageSubject ?title ;"
                                         "      nmo:messageSubject ?description ;"
                                         "      nie:url ?uri ;"
@@ -147,7 +203,7 @@ static const gchar *queries[INVENIO_CATEGORIES] =
 
     [INVENIO_CATEGORY_MUSIC]        =   SPARQL_QUERY_HEADER
                                         " ?urn a nfo:Audio ."
-                                        " ?urn fts:match \"%s*\" ."
+                                        " ?urn fts:match \"%s\" ."
                                         " ?urn nfo:fileName ?title ;"
                                         "      nie:url ?uri ;"
                                         "      nie:url ?location ."
@@ -156,7 +212,7 @@ static const gchar *queries[INVENIO_CATEGORIES] =
 
     [INVENIO_CATEGORY_VIDEO]        =   SPARQL_QUERY_HEADER
                                         " ?urn a nfo:Video ."
-                                        " ?urn fts:match \"%s*\" ."
+                                        " ?urn fts:match \"%s\" ."
                                         " ?urn nfo:fileName ?title ;"
                                         "      nie:url ?uri ;"
                                         "      nie:url ?location ."
@@ -165,23 +221,163 @@ static const gchar *queries[INVENIO_CATEGORIES] =
 };
 
 
+void
+invenio_query_connect (void)
+{
+    if (G_UNLIKELY (! client))
+        client = tracker_client_new (TRACKER_CLIENT_ENABLE_WARNINGS, G_MAXINT);
+}
+
+static void
+warm_up_collect_results (GPtrArray  *results,
+                         GError     *error,
+                         gpointer    user_data)
+{
+    InvenioQueryWarmUp *warm_up;
+    gint64 duration;
+
+    warm_up = (InvenioQueryWarmUp *) user_data;
+
+    if (error)
+    {
+        g_debug ("Tracker warm-up query failed: %s", error->message);
+        g_error_free (error);
+    }
+
+    if (results)
+    {
+        g_ptr_array_foreach (results, (GFunc) g_strfreev, NULL);
+        g_ptr_array_free (results, TRUE);
+    }
+
+    if (--warm_up->outstanding)
+        return;
+
+    duration = g_get_monotonic_time () - warm_up->start;
+    g_debug ("Tracker warmed up in %.3f ms", duration / 1000.0);
+
+    if (warm_up->callback)
+        warm_up->callback (duration, warm_up->user_data);
+
+    g_slice_free (InvenioQueryWarmUp, warm_up);
+}
+
+void
+invenio_query_warm_up (const guint           categories,
+                       InvenioQueryWarmedUp  callback,
+                       gpointer              user_data)
+{
+    const InvenioConfigurationSnapshot *configuration;
+    InvenioQueryWarmUp *warm_up;
+    InvenioCategory category;
+    gchar *query;
+
+    configuration = invenio_configuration_get_snapshot ();
+
+    warm_up = g_slice_new0 (InvenioQueryWarmUp);
+    warm_up->start = g_get_monotonic_time ();
+    warm_up->callback = callback;
+    warm_up->user_data = user_data;
+
+    invenio_query_connect ();
+
+    /*
+     * Issue a cheap query per enabled category (of those given, as a mask) so
+     * that the D-Bus connection is established and Tracker has its full text
+     * index warm before the first keystroke.  The outstanding count is biased
+     * by one until all of the queries have been issued.
+     */
+    warm_up->outstanding = 1;
+
+    for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+    {
+        if (! configuration->category_enabled[category]
+            || ! (categories & (1 << category)))
+            continue;
+
+        query = g_strdup_printf (queries[category], "a*", "", 0, 1);
+
+        warm_up->outstanding++;
+        tracker_resources_sparql_query_async (client, query, warm_up_collect_results, warm_up);
+
+        g_free (query);
+    }
+
+    warm_up_collect_results (NULL, NULL, warm_up);
+}
+
+static void
+query_owner_free (gpointer data)
+{
+    g_slice_free (InvenioQueryOwner, data);
+}
+
 InvenioQuery *
 invenio_query_new (const gchar * const keywords)
 {
+    const InvenioConfigurationSnapshot *configuration;
+    InvenioQueryAst *ast;
     InvenioQuery *query;
     InvenioCategory category;
+    guint i;
+
+    configuration = invenio_configuration_get_snapshot ();
 
     query = g_slice_new0 (InvenioQuery);
 
+    /*
+     * The search is parsed once, and compiled to escaped SPARQL.  Filters
+     * restrict the categories which are searched at all, and a search with
+     * nothing to match does not reach tracker.
+     */
+    ast = invenio_query_parse (keywords);
+
+    query->keywords = invenio_query_ast_get_text (ast);
+    query->categories = invenio_query_ast_get_categories (ast);
+
+    if (! invenio_query_ast_to_sparql (ast, &query->match, &query->filter))
+        query->categories = 0;
+
+    invenio_query_ast_free (ast);
+
+    query->pattern = invenio_fuzzy_pattern_new (query->keywords);
+    query->owners = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, query_owner_free);
+
     for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
-    {
-        query->queries[category].query = g_strdup_printf (queries[category], keywords);
         query->queries[category].valid = FALSE;
-    }
+
+    for (i = 0; i < INVENIO_CATEGORIES; i++)
+        query->precedence[configuration->category_precedence[i]] = i;
 
     return query;
 }
 
+static void
+query_cancel_category (InvenioQuery             *query,
+                       const InvenioCategory     category)
+{
+    InvenioTrackerQuery *tracker_query;
+
+    tracker_query = &query->queries[category];
+
+    if (tracker_query->timeout_id)
+    {
+        g_source_remove (tracker_query->timeout_id);
+        tracker_query->timeout_id = 0;
+    }
+
+    if (tracker_query->valid)
+    {
+        tracker_cancel_call (client, tracker_query->id);
+        tracker_query->valid = FALSE;
+        tracker_query->wanted = 0;
+
+        g_slice_free (InvenioQueryRequest, tracker_query->request);
+        tracker_query->request = NULL;
+    }
+}
+
 void
 invenio_query_free (InvenioQuery *query)
 {
@@ -189,17 +385,19 @@ invenio_query_free (InvenioQuery *query)
 
     for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
     {
-        if (query->queries[category].valid)
-            tracker_cancel_call (client, query->queries[category].id);
+        query_cancel_category (query, category);
 
-        g_free (query->queries[category].query);
         g_slist_foreach (query->queries[category].results, (GFunc) invenio_query_result_free, NULL);
-
+        g_slist_free (query->queries[category].results);
+        g_slist_foreach (query->queries[category].spare, (GFunc) invenio_query_result_free, NULL);
+        g_slist_free (query->queries[category].spare);
     }
 
-    if (query->error)
-        g_error_free (query->error);
-
+    g_free (query->keywords);
+    g_free (query->match);
+    g_free (query->filter);
+    invenio_fuzzy_pattern_free (query->pattern);
+    g_hash_table_destroy (query->owners);
     g_slice_free (InvenioQuery, query);
 }
 
@@ -208,14 +406,10 @@ query_collect_result (gpointer  data,
                       gpointer  user_data)
 {
     const gchar **metadata;
-    InvenioQueryRequest *request;
-    InvenioQuery *query;
-    InvenioCategory category;
+    GSList **page;
 
     metadata = (const gchar **) data;
-    request = (InvenioQueryRequest *) user_data;
-    query = request->query;
-    category = request->category;
+    page = (GSList **) user_data;
 
     /*
      * NOTE: Metadata content is determined by the SPARQL query.  The order of
@@ -227,12 +421,203 @@ query_collect_result (gpointer  data,
      * safety when the query results change.
      */
 
-    query->queries[category].results =
-        g_slist_prepend (query->queries[category].results,
-                         invenio_query_result_new (metadata[0],     /* title */
-                                                   metadata[1],     /* description */
-                                                   metadata[2],     /* uri */
-                                                   metadata[3]));   /* location */
+    *page = g_slist_prepend (*page,
+                             invenio_query_result_new (metadata[0],     /* title */
+                                                       metadata[1],     /* description */
+                                                       metadata[2],     /* uri */
+                                                       metadata[3]));   /* location */
+}
+
+static gint
+query_compare_ranked (gconstpointer a,
+                      gconstpointer b)
+{
+    const InvenioQueryRankedResult * const lhs = a;
+    const InvenioQueryRankedResult * const rhs = b;
+
+    if (lhs->history != rhs->history)
+        return lhs->history > rhs->history ? -1 : 1;
+    if (lhs->matched != rhs->matched)
+        return lhs->matched ? -1 : 1;
+    if (lhs->match != rhs->match)
+        return lhs->match > rhs->match ? -1 : 1;
+
+    /* otherwise keep tracker's order */
+    return (lhs->position > rhs->position) - (lhs->position < rhs->position);
+}
+
+/*
+ * Orders a page of results: those launched before first, then those whose
+ * title fuzzily matches the keywords (tracker also matches other properties),
+ * best match first.  The scores are computed once per row rather than on each
+ * comparison.
+ */
+static GSList *
+query_rank_page (InvenioQuery   *query,
+                 GSList         *page)
+{
+    InvenioQueryRankedResult *ranked;
+    GSList *entry;
+    guint i, length;
+
+    if (! (length = g_slist_length (page)))
+        return page;
+
+    ranked = g_new (InvenioQueryRankedResult, length);
+
+    for (i = 0, entry = page; entry; i++, entry = entry->next)
+    {
+        ranked[i].result = entry->data;
+        ranked[i].position = i;
+        ranked[i].history = invenio_history_get_score (entry->data);
+        ranked[i].match = 0.0;
+        ranked[i].matched =
+            invenio_fuzzy_pattern_match (query->pattern,
+                                         invenio_query_result_get_normalized_title (entry->data),
+                                         &ranked[i].match);
+    }
+
+    qsort (ranked, length, sizeof (*ranked), query_compare_ranked);
+
+    for (i = 0, entry = page; entry; i++, entry = entry->next)
+        entry->data = ranked[i].result;
+
+    g_free (ranked);
+
+    return page;
+}
+
+/* moves up to count spare rows to the end of the displayed results */
+static guint
+query_take_spare (InvenioTrackerQuery   *tracker_query,
+                  const guint            count)
+{
+    GSList *taken, *last;
+    guint i;
+
+    if (! count || ! tracker_query->spare)
+        return 0;
+
+    taken = tracker_query->spare;
+
+    for (i = 1, last = taken; i < count && last->next; i++)
+        last = last->next;
+
+    tracker_query->spare = last->next;
+    last->next = NULL;
+
+    tracker_query->results = g_slist_concat (tracker_query->results, taken);
+
+    return i;
+}
+
+/*
+ * The same resource is often returned under several categories (an image is
+ * also a document, a bookmark links to a file), so results are keyed by their
+ * uri with escapes decoded, file uris reduced to their path and any trailing
+ * slash removed.
+ */
+static gchar *
+query_normalize_uri (const InvenioQueryResult * const result)
+{
+    const gchar *uri;
+    gchar *key;
+    gsize length;
+
+    if (! (uri = invenio_query_result_get_uri (result)))
+        uri = invenio_query_result_get_location (result);
+
+    if (! uri)
+        return NULL;
+
+    if (! g_str_has_prefix (uri, "file:") || ! (key = g_filename_from_uri (uri, NULL, NULL)))
+        if (! (key = g_uri_unescape_string (uri, NULL)))
+            key = g_strdup (uri);
+
+    length = strlen (key);
+    if (length > 1 && key[length - 1] == '/')
+        key[length - 1] = '\0';
+
+    return key;
+}
+
+/* drops a result which is now held by a category of higher precedence */
+static void
+query_remove_result (InvenioQuery           *query,
+                     const InvenioCategory   category,
+                     InvenioQueryResult     *result)
+{
+    InvenioTrackerQuery *tracker_query;
+
+    tracker_query = &query->queries[category];
+
+    if (g_slist_find (tracker_query->results, result))
+    {
+        /* backfill the displayed results from the rows fetched ahead */
+        tracker_query->results = g_slist_remove (tracker_query->results, result);
+        query_take_spare (tracker_query, 1);
+    }
+    else
+    {
+        tracker_query->spare = g_slist_remove (tracker_query->spare, result);
+    }
+
+    invenio_query_result_free (result);
+}
+
+/*
+ * Keeps each resource in one category only, the one of highest precedence to
+ * return it.  Rows of the page which another category already holds are
+ * dropped, and rows the page's category takes over are removed from the
+ * category that held them; those categories are flagged in displaced.
+ */
+static GSList *
+query_deduplicate (InvenioQuery             *query,
+                   const InvenioCategory     category,
+                   GSList                   *page,
+                   guint                    *displaced)
+{
+    InvenioQueryOwner *owner;
+    GSList *entry, *next;
+    gchar *key;
+
+    for (entry = page; entry; entry = next)
+    {
+        next = entry->next;
+
+        if (! (key = query_normalize_uri (entry->data)))
+            continue;
+
+        owner = g_hash_table_lookup (query->owners, key);
+
+        if (! owner)
+        {
+            owner = g_slice_new (InvenioQueryOwner);
+            owner->category = category;
+            owner->result = entry->data;
+
+            g_hash_table_insert (query->owners, key, owner);
+            continue;
+        }
+
+        g_free (key);
+
+        if (owner->category == category
+            || query->precedence[owner->category] < query->precedence[category])
+        {
+            invenio_query_result_free (entry->data);
+            page = g_slist_delete_link (page, entry);
+            continue;
+        }
+
+        query_remove_result (query, owner->category, owner->result);
+        *displaced |= (1 << owner->category);
+
+        owner->category = category;
+        owner->result = entry->data;
+    }
+
+    return page;
 }
 
 static void
@@ -240,28 +625,120 @@ query_collect_results (GPtrArray    *results,
                        GError       *error,
                        gpointer      user_data)
 {
+    InvenioTrackerQuery *tracker_query;
     InvenioQueryRequest *request;
     InvenioQuery *query;
-    InvenioCategory category;
+    InvenioCategory category, other;
+    GSList *page = NULL;
+    guint displaced = 0;
 
     request = (InvenioQueryRequest *) user_data;
     query = request->query;
     category = request->category;
+    tracker_query = &query->queries[category];
 
-    query->error = error;
-    query->queries[category].valid = FALSE;
+    tracker_query->valid = FALSE;
+    tracker_query->request = NULL;
+
+    if (tracker_query->timeout_id)
+    {
+        g_source_remove (tracker_query->timeout_id);
+        tracker_query->timeout_id = 0;
+    }
 
     if (! error && results)
     {
-        g_ptr_array_foreach (results, query_collect_result, request);
-        query->queries[category].results = g_slist_reverse (query->queries[category].results);
+        g_ptr_array_foreach (results, query_collect_result, &page);
+
+        page = query_rank_page (query, g_slist_reverse (page));
+        page = query_deduplicate (query, category, page, &displaced);
+
+        if (tracker_query->provisional)
+        {
+            g_slist_foreach (tracker_query->results, (GFunc) invenio_query_result_free, NULL);
+            g_slist_free (tracker_query->results);
+            tracker_query->results = NULL;
+            tracker_query->provisional = FALSE;
+        }
+
+        tracker_query->fetched += results->len;
+        tracker_query->exhausted = (results->len < request->count);
+        tracker_query->spare = g_slist_concat (tracker_query->spare, page);
 
         g_ptr_array_foreach (results, (GFunc) g_strfreev, NULL);
         g_ptr_array_free (results, TRUE);
     }
 
+    query_take_spare (tracker_query, tracker_query->wanted);
+    tracker_query->wanted = 0;
+
     g_slice_free (InvenioQueryRequest, request);
-    query->callback (query, category, query->error, query->user_data);
+
+    /* ownership of the error is passed on to the callback */
+    query->callback (query, category, error, query->user_data);
+
+    for (other = (InvenioCategory) 0; other != INVENIO_CATEGORIES; other++)
+        if (displaced & (1 << other))
+            query->callback (query, other, NULL, query->user_data);
+}
+
+static gboolean
+query_timeout (gpointer user_data)
+{
+    InvenioQueryRequest *request;
+    InvenioQuery *query;
+    InvenioCategory category;
+
+    request = (InvenioQueryRequest *) user_data;
+    query = request->query;
+    category = request->category;
+
+    query->queries[category].timeout_id = 0;
+    query_cancel_category (query, category);
+
+    query->callback (query, category,
+                     g_error_new_literal (G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                                          "Timed out waiting for results"),
+                     query->user_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+query_dispatch (InvenioQuery                        *query,
+                const InvenioCategory                category,
+                const InvenioConfigurationSnapshot  *configuration)
+{
+    InvenioTrackerQuery *tracker_query;
+    InvenioQueryRequest *request;
+    gchar *sparql;
+
+    tracker_query = &query->queries[category];
+
+    /*
+     * Over-fetch so that the next page can usually be shown from the spare
+     * rows without another round trip to tracker.
+     */
+    request = g_slice_new0 (InvenioQueryRequest);
+    request->query = query;
+    request->category = category;
+    request->count = configuration->category_limit[category] * INVENIO_QUERY_OVERFETCH;
+
+    sparql = g_strdup_printf (queries[category], query->match, query->filter,
+                              tracker_query->fetched, request->count);
+
+    tracker_query->id =
+        tracker_resources_sparql_query_async (client, sparql, query_collect_results, request);
+    tracker_query->valid = TRUE;
+    tracker_query->request = request;
+    tracker_query->wanted = configuration->category_limit[category];
+
+    if (configuration->category_timeout[category])
+        tracker_query->timeout_id =
+            g_timeout_add (configuration->category_timeout[category],
+                           query_timeout, request);
+
+    g_free (sparql);
 }
 
 void
@@ -269,45 +746,110 @@ invenio_query_execute_async (InvenioQuery           *query,
                              InvenioQueryCompleted   callback,
                              gpointer                user_data)
 {
-    InvenioQueryRequest *request;
+    const InvenioConfigurationSnapshot *configuration;
     InvenioCategory category;
 
     query->callback = callback;
     query->user_data = user_data;
 
-    if (G_UNLIKELY (! client))
-        client = tracker_client_new (TRACKER_CLIENT_ENABLE_WARNINGS, G_MAXINT);
+    invenio_query_connect ();
+
+    configuration = invenio_configuration_get_snapshot ();
 
     for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
     {
-        if (invenio_configuration_get_search_category (category))
-        {
-            request = g_slice_new0 (InvenioQueryRequest);
+        if (! configuration->category_enabled[category]
+            || ! (query->categories & (1 << category)))
+            continue;
+
+        query_dispatch (query, category, configuration);
 
-            request->query = query;
-            request->category = category;
+        /* show what was launched before for these keywords while tracker runs */
+        query->queries[category].results =
+            invenio_history_lookup (query->keywords, category,
+                                    configuration->category_limit[category]);
 
-            query->queries[category].id =
-                tracker_resources_sparql_query_async (client, query->queries[category].query,
-                                                      query_collect_results, request);
-            query->queries[category].valid = TRUE;
+        if (query->queries[category].results)
+        {
+            query->queries[category].provisional = TRUE;
+            query->callback (query, category, NULL, query->user_data);
         }
     }
 }
 
+gboolean
+invenio_query_fetch_more (InvenioQuery          *query,
+                          const InvenioCategory  category)
+{
+    const InvenioConfigurationSnapshot *configuration;
+    InvenioTrackerQuery *tracker_query;
+    guint limit;
+
+    tracker_query = &query->queries[category];
+
+    /* nothing has been executed yet, or a page is already on its way */
+    if (! query->callback || tracker_query->valid)
+        return FALSE;
+
+    /* only a category which was searched, and has more to show, can continue */
+    if (! query->match
+        || ! (query->categories & (1 << category))
+        || ! invenio_query_has_more (query, category))
+        return FALSE;
+
+    configuration = invenio_configuration_get_snapshot ();
+    if (! configuration->category_enabled[category])
+        return FALSE;
+
+    limit = configuration->category_limit[category];
+
+    if (tracker_query->exhausted || g_slist_length (tracker_query->spare) >= limit)
+    {
+        if (! query_take_spare (tracker_query, limit))
+            return FALSE;
+
+        query->callback (query, category, NULL, query->user_data);
+        return TRUE;
+    }
+
+    /* continue after the rows fetched so far; the spare rows are shown first */
+    query_dispatch (query, category, configuration);
+
+    return TRUE;
+}
+
+gboolean
+invenio_query_has_more (const InvenioQuery * const query,
+                        const InvenioCategory      category)
+{
+    const InvenioTrackerQuery *tracker_query;
+
+    tracker_query = &query->queries[category];
+
+    return tracker_query->spare
+        || (tracker_query->fetched && ! tracker_query->exhausted);
+}
+
 void
 invenio_query_cancel (InvenioQuery *query)
 {
     InvenioCategory category;
 
     for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
-    {
-        if (query->queries[category].valid)
-        {
-            tracker_cancel_call (client, query->queries[category].id);
-            query->queries[category].valid = FALSE;
-        }
-    }
+        query_cancel_category (query, category);
+}
+
+const gchar *
+invenio_query_get_keywords (const InvenioQuery * const query)
+{
+    return query->keywords;
+}
+
+/* the categories which the search is dispatched to, as a mask */
+guint
+invenio_query_get_categories (const InvenioQuery * const query)
+{
+    return query->categories;
 }
 
 const GSList *
@@ -37,6 +37,15 @@
 
 typedef struct InvenioQuery InvenioQuery;
 typedef void (*InvenioQueryCompleted)(InvenioQuery *query, const InvenioCategory category, GError *error, gpointer user_data);
+typedef void (*InvenioQueryWarmedUp)(const gint64 duration, gpointer user_data);
+
+void
+invenio_query_connect (void);
+
+void
+invenio_query_warm_up (const guint           categories,
+                       InvenioQueryWarmedUp  callback,
+                       gpointer              user_data);
 
 InvenioQuery *
 invenio_query_new (const gchar * const keywords);
@@ -52,6 +61,20 @@ invenio_query_execute_async (InvenioQuery           *query,
 void
 invenio_query_cancel (InvenioQuery *query);
 
+gboolean
+invenio_query_fetch_more (InvenioQuery          *query,
+                          const InvenioCategory  category);
+
+gboolean
+invenio_query_has_more (const InvenioQuery * const query,
+                        const InvenioCategory      category);
+
+const gchar *
+invenio_query_get_keywords (const InvenioQuery * const query);
+
+guint
+invenio_query_get_categories (const InvenioQuery * const query);
+
 const GSList *
 invenio_query_get_results_for_category (const InvenioQuery * const query,
                                         const InvenioCategory      category);
@@ -0,0 +1,281 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "invenio-history.h"
+#include "invenio-ranking.h"
+
+#include "libinvenio/invenio-fuzzy.h"
+#include "libinvenio/invenio-normalize.h"
+
+/* weights of the components of the default score */
+#define INVENIO_RANKING_WEIGHT_POSITION         (1.0)
+#define INVENIO_RANKING_WEIGHT_MATCH            (1.0)
+#define INVENIO_RANKING_WEIGHT_LENGTH           (0.5)
+#define INVENIO_RANKING_WEIGHT_HISTORY          (1.0)
+
+
+typedef struct InvenioRankingEntry
+{
+    gdouble              score;
+    guint                sequence;
+
+    InvenioCategory      category;
+    InvenioQueryResult  *result;
+} InvenioRankingEntry;
+
+struct InvenioRanking
+{
+    gchar               *keywords;
+    InvenioFuzzyPattern *pattern;
+
+    InvenioRankingScore  score;
+    gpointer             user_data;
+
+    /* a min-heap of the best entries offered so far, the worst at the root */
+    InvenioRankingEntry *heap;
+    guint                size;
+    guint                length;
+
+    guint                sequence;
+    guint                offered;
+};
+
+
+/* whether a ranks below b; of equal scores, the one offered later is worse */
+static inline gboolean
+_entry_below (const InvenioRankingEntry * const a,
+              const InvenioRankingEntry * const b)
+{
+    return a->score < b->score
+        || (a->score == b->score && a->sequence > b->sequence);
+}
+
+static void
+_sift_up (InvenioRanking    *ranking,
+          guint              index)
+{
+    InvenioRankingEntry entry;
+    guint parent;
+
+    entry = ranking->heap[index];
+
+    for (; index > 0; index = parent)
+    {
+        parent = (index - 1) / 2;
+
+        if (! _entry_below (&entry, &ranking->heap[parent]))
+            break;
+
+        ranking->heap[index] = ranking->heap[parent];
+    }
+
+    ranking->heap[index] = entry;
+}
+
+static void
+_sift_down (InvenioRanking  *ranking,
+            guint            index)
+{
+    InvenioRankingEntry entry;
+    guint child;
+
+    entry = ranking->heap[index];
+
+    for (; (child = 2 * index + 1) < ranking->length; index = child)
+    {
+        if (child + 1 < ranking->length
+            && _entry_below (&ranking->heap[child + 1], &ranking->heap[child]))
+            child++;
+
+        if (! _entry_below (&ranking->heap[child], &entry))
+            break;
+
+        ranking->heap[index] = ranking->heap[child];
+    }
+
+    ranking->heap[index] = entry;
+}
+
+InvenioRanking *
+invenio_ranking_new (const gchar * const    keywords,
+                     const guint            size,
+                     InvenioRankingScore    score,
+                     gpointer               user_data)
+{
+    InvenioRanking *ranking;
+
+    ranking = g_slice_new0 (InvenioRanking);
+    ranking->keywords = invenio_normalize (keywords);
+    ranking->pattern = invenio_fuzzy_pattern_new (ranking->keywords);
+    ranking->score = score ? score : invenio_ranking_default_score;
+    ranking->user_data = user_data;
+    ranking->heap = g_new (InvenioRankingEntry, size);
+    ranking->size = size;
+
+    return ranking;
+}
+
+void
+invenio_ranking_free (InvenioRanking *ranking)
+{
+    g_free (ranking->keywords);
+    invenio_fuzzy_pattern_free (ranking->pattern);
+    g_free (ranking->heap);
+    g_slice_free (InvenioRanking, ranking);
+}
+
+void
+invenio_ranking_reset (InvenioRanking *ranking)
+{
+    ranking->length = 0;
+    ranking->sequence = 0;
+    ranking->offered = 0;
+}
+
+/*
+ * Scores each of the results and keeps it if it is among the best seen so far.
+ * A result which ranks below the root of a full heap is dropped right away, so
+ * the cost is linear in the rows offered (with a log factor of the heap size).
+ */
+void
+invenio_ranking_offer (InvenioRanking       *ranking,
+                       const InvenioCategory category,
+                       const GSList         *results)
+{
+    InvenioRankingCandidate candidate;
+    InvenioRankingEntry entry;
+    const GSList *node;
+
+    candidate.keywords = ranking->keywords;
+    candidate.pattern = ranking->pattern;
+    candidate.category = category;
+    candidate.position = 0;
+
+    ranking->offered |= (1 << category);
+
+    if (! ranking->size)
+        return;
+
+    for (node = results; node; node = node->next, candidate.position++)
+    {
+        candidate.result = node->data;
+
+        entry.score = ranking->score (&candidate, ranking->user_data);
+        entry.sequence = ranking->sequence++;
+        entry.category = category;
+        entry.result = node->data;
+
+        if (ranking->length < ranking->size)
+        {
+            ranking->heap[ranking->length] = entry;
+            _sift_up (ranking, ranking->length++);
+        }
+        else if (_entry_below (&ranking->heap[0], &entry))
+        {
+            ranking->heap[0] = entry;
+            _sift_down (ranking, 0);
+        }
+    }
+}
+
+gboolean
+invenio_ranking_has_category (const InvenioRanking * const ranking,
+                              const InvenioCategory        category)
+{
+    return (ranking->offered & (1 << category)) != 0;
+}
+
+static gint
+_compare_entries (gconstpointer a,
+                  gconstpointer b)
+{
+    const InvenioRankingEntry * const lhs = a;
+    const InvenioRankingEntry * const rhs = b;
+
+    if (_entry_below (rhs, lhs))
+        return -1;
+    if (_entry_below (lhs, rhs))
+        return 1;
+    return 0;
+}
+
+/* copies out the kept results, best first; only the heap itself is sorted */
+guint
+invenio_ranking_get_results (const InvenioRanking * const ranking,
+                             InvenioQueryResult         **results,
+                             InvenioCategory             *categories)
+{
+    InvenioRankingEntry *sorted;
+    guint i;
+
+    sorted = g_memdup (ranking->heap, ranking->length * sizeof (*sorted));
+    qsort (sorted, ranking->length, sizeof (*sorted), _compare_entries);
+
+    for (i = 0; i < ranking->length; i++)
+    {
+        results[i] = sorted[i].result;
+        categories[i] = sorted[i].category;
+    }
+
+    g_free (sorted);
+
+    return ranking->length;
+}
+
+/*
+ * The default score combines the backend's ordering within the category, how
+ * well the keywords fuzzily match the title, how much of the title the keywords
+ * cover and how often the result has been launched.
+ */
+gdouble
+invenio_ranking_default_score (const InvenioRankingCandidate * const candidate,
+                               gpointer                            user_data)
+{
+    const InvenioFuzzyText *title;
+    gdouble score, match;
+    gsize length;
+
+    title = invenio_query_result_get_normalized_title (candidate->result);
+
+    score = INVENIO_RANKING_WEIGHT_POSITION / (1.0 + candidate->position);
+    if (invenio_fuzzy_pattern_match (candidate->pattern, title, &match))
+        score += INVENIO_RANKING_WEIGHT_MATCH * match;
+
+    if (title && (length = invenio_fuzzy_text_get_length (title)) > 0)
+        score += INVENIO_RANKING_WEIGHT_LENGTH
+               * MIN (1.0, (gdouble) g_utf8_strlen (candidate->keywords, -1) / length);
+
+    score += INVENIO_RANKING_WEIGHT_HISTORY * log1p (invenio_history_get_score (candidate->result));
+
+    return score;
+}
@@ -0,0 +1,87 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#ifndef __INVENIO_RANKING_H__
+#define __INVENIO_RANKING_H__
+
+#include <glib.h>
+
+#include "invenio-query-result.h"
+#include "libinvenio/invenio-category.h"
+#include "libinvenio/invenio-fuzzy.h"
+
+typedef struct InvenioRanking InvenioRanking;
+
+typedef struct InvenioRankingCandidate
+{
+    /* normalized, as are the titles they are matched against */
+    const gchar         *keywords;
+    InvenioFuzzyPattern *pattern;
+    InvenioCategory      category;
+    InvenioQueryResult  *result;
+
+    /* position of the result in the backend's ordering for the category */
+    guint                position;
+} InvenioRankingCandidate;
+
+typedef gdouble (*InvenioRankingScore)(const InvenioRankingCandidate * const candidate, gpointer user_data);
+
+InvenioRanking *
+invenio_ranking_new (const gchar * const    keywords,
+                     const guint            size,
+                     InvenioRankingScore    score,
+                     gpointer               user_data);
+
+void
+invenio_ranking_free (InvenioRanking *ranking);
+
+void
+invenio_ranking_reset (InvenioRanking *ranking);
+
+void
+invenio_ranking_offer (InvenioRanking       *ranking,
+                       const InvenioCategory category,
+                       const GSList         *results);
+
+gboolean
+invenio_ranking_has_category (const InvenioRanking * const ranking,
+                              const InvenioCategory        category);
+
+guint
+invenio_ranking_get_results (const InvenioRanking * const ranking,
+                             InvenioQueryResult         **results,
+                             InvenioCategory             *categories);
+
+gdouble
+invenio_ranking_default_score (const InvenioRankingCandidate * const candidate,
+                               gpointer                            user_data);
+
+#endif
+
@@ -31,27 +31,46 @@
 #include <string.h>
 
 #include <X11/Xlib.h>
+#include <X11/Xatom.h>
 
 #include <gdk/gdkx.h>
 #include <gdk/gdkkeysyms.h>
 #include <gdk/gdkkeysyms-compat.h>
 
-#include <libwnck/libwnck.h>
-
 #include "invenio-query.h"
+#include "invenio-history.h"
+#include "invenio-ranking.h"
 #include "invenio-query-result.h"
 #include "invenio-search-window.h"
 
 #include "libinvenio/invenio-category.h"
+#include "libinvenio/invenio-configuration.h"
 
 #define INVENIO_SEARCH_WINDOW_WIDTH             (340)
 
+/* resolved icons are kept for this many uris before the cache is dropped */
+#define INVENIO_SEARCH_WINDOW_ICON_CACHE_SIZE   (256)
+
 
 typedef struct InvenioSearchResults
 {
-    GtkListStore    *model;
-    GtkWidget       *view;
-    guint            count;
+    GtkListStore        *model;
+    GtkWidget           *view;
+    GtkTreeViewColumn   *category_column;
+    guint                count;
+
+    /* number of rows and display rank for each category */
+    guint                rows[INVENIO_CATEGORIES];
+    guint                rank[INVENIO_CATEGORIES];
+
+    /* the best matches across categories, when not grouping by category */
+    InvenioRanking      *ranking;
+    guint                best_matches;
+
+    /* categories whose results arrived since the last frame */
+    guint                pending;
+    guint                flush_id;
+    gboolean             flush_on_tick;
 } InvenioSearchResults;
 
 typedef struct InvenioSearchWindow
@@ -59,7 +78,19 @@ typedef struct InvenioSearchWindow
     GtkWidget               *window;
     GtkWidget               *entry;
     InvenioQuery            *query;
+    gint64                   query_time;
     InvenioSearchResults    *results;
+
+    /* icons by uri, NULL for uris without one */
+    GHashTable              *icons;
+    guint                    suggest_id;
+
+    /* monotonic time at which the pending summon was requested */
+    gint64                   summon_time;
+
+    /* _NET_CURRENT_DESKTOP tracking */
+    Atom                     net_current_desktop;
+    glong                    current_desktop;
 } InvenioSearchWindow;
 
 typedef enum InvenioSearchResultColumn
@@ -87,9 +118,44 @@ static const GType InvenioSearchResultColumnType[INVENIO_SEARCH_RESULT_COLUMNS]
 #define COLUMN_TYPE(column)                     (InvenioSearchResultColumnType[(column)])
 
 
+static InvenioSearchWindow *search_window_default;
+
+
+static void invenio_search_window_suggest (InvenioSearchWindow *search_window);
+
+static void
+invenio_search_window_cancel_flush (InvenioSearchWindow *search_window)
+{
+    if (search_window->results->flush_id)
+    {
+        if (search_window->results->flush_on_tick)
+            gtk_widget_remove_tick_callback (search_window->window,
+                                             search_window->results->flush_id);
+        else
+            g_source_remove (search_window->results->flush_id);
+
+        search_window->results->flush_id = 0;
+    }
+
+    search_window->results->pending = 0;
+}
+
+static void
+invenio_search_window_free_ranking (InvenioSearchWindow *search_window)
+{
+    if (search_window->results->ranking)
+    {
+        invenio_ranking_free (search_window->results->ranking);
+        search_window->results->ranking = NULL;
+    }
+}
+
 static void
 invenio_search_window_reset_search (InvenioSearchWindow *search_window)
 {
+    invenio_search_window_cancel_flush (search_window);
+    invenio_search_window_free_ranking (search_window);
+
     if (search_window->query)
     {
         invenio_query_free (search_window->query);
@@ -98,7 +164,26 @@ invenio_search_window_reset_search (InvenioSearchWindow *search_window)
 
     gtk_entry_set_text (GTK_ENTRY (search_window->entry), "");
     gtk_list_store_clear (search_window->results->model);
+    memset (search_window->results->rows, 0, sizeof (search_window->results->rows));
     search_window->results->count = 0;
+
+    invenio_search_window_suggest (search_window);
+}
+
+static void
+invenio_search_window_hide (InvenioSearchWindow *search_window)
+{
+    gtk_widget_hide (search_window->window);
+
+    /*
+     * With a warm hide, the entry text, the model and the query results are
+     * kept so that they can be presented immediately when the window is
+     * summoned again.
+     */
+    if (! invenio_configuration_get_snapshot ()->warm_hide)
+        invenio_search_window_reset_search (search_window);
+    else if (! search_window->query)
+        invenio_search_window_suggest (search_window);
 }
 
 static gboolean
@@ -110,9 +195,7 @@ invenio_search_window_focus_out (GtkWidget      *widget,
 
     search_window = (InvenioSearchWindow *) user_data;
 
-    /* XXX Should this reset or just hide? */
-    gtk_widget_hide (search_window->window);
-    invenio_search_window_reset_search (search_window);
+    invenio_search_window_hide (search_window);
 
     return TRUE;
 }
@@ -205,7 +288,8 @@ static void
 invenio_search_window_activate_selected_result (InvenioSearchWindow *search_window,
                                                 const gboolean alternate_action)
 {
-    gchar *uri;
+    gchar *uri, *title, *description, *location;
+    InvenioCategory category;
     GtkTreePath *path;
     GtkTreeSelection *selection;
     GtkTreeIter iter;
@@ -216,30 +300,34 @@ invenio_search_window_activate_selected_result (InvenioSearchWindow *search_wind
     {
         path = gtk_tree_model_get_path (GTK_TREE_MODEL (search_window->results->model), &iter);
 
+        gtk_tree_model_get (GTK_TREE_MODEL (search_window->results->model), &iter,
+                            INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, &category,
+                            INVENIO_SEARCH_RESULT_COLUMN_TITLE, &title,
+                            INVENIO_SEARCH_RESULT_COLUMN_DESCRIPTION, &description,
+                            INVENIO_SEARCH_RESULT_COLUMN_URI, &uri,
+                            INVENIO_SEARCH_RESULT_COLUMN_LOCATION, &location,
+                            -1);
+
+        /* remember the launch so that the result ranks higher next time */
+        invenio_history_record (category, title, description, uri, location);
+
         if (alternate_action)
         {
             char *temp;
 
-            gtk_tree_model_get (GTK_TREE_MODEL (search_window->results->model), &iter,
-                                INVENIO_SEARCH_RESULT_COLUMN_LOCATION, &uri, -1);
-
-            temp = g_path_get_dirname (uri);
+            temp = g_path_get_dirname (location);
             g_free (uri);
             uri = temp;
         }
-        else
-        {
-            gtk_tree_model_get (GTK_TREE_MODEL (search_window->results->model), &iter,
-                                INVENIO_SEARCH_RESULT_COLUMN_URI, &uri, -1);
-        }
 
         _launch_uri (uri, gtk_widget_get_screen (search_window->window));
 
         g_free (uri);
+        g_free (title);
+        g_free (description);
+        g_free (location);
 
-        /* XXX Should this reset or just hide? */
-        gtk_widget_hide (search_window->window);
-        invenio_search_window_reset_search (search_window);
+        invenio_search_window_hide (search_window);
     }
 }
 
@@ -284,9 +372,7 @@ invenio_search_window_key_press (GtkWidget      *widget,
             return FALSE;
 
         case GDK_Escape:
-            /* XXX Should this reset or just hide? */
-            gtk_widget_hide (search_window->window);
-            invenio_search_window_reset_search (search_window);
+            invenio_search_window_hide (search_window);
             return FALSE;
 
         case GDK_Return:
@@ -305,40 +391,70 @@ invenio_search_window_key_press (GtkWidget      *widget,
     return GTK_WIDGET_GET_CLASS (search_window->window)->key_press_event (widget, event);
 }
 
-static void
-invenio_search_window_map (GtkWidget    *widget,
-                           gpointer      user_data)
+static glong
+_get_current_desktop (InvenioSearchWindow *search_window)
 {
-    GdkDisplay *display;
-    GdkWindow  *window;
+    GdkWindow *root;
+    Atom type;
+    gint format;
+    gulong items, remaining;
+    guchar *data = NULL;
+    glong desktop = -1;
+
+    root = gdk_get_default_root_window ();
+
+    gdk_error_trap_push ();
+
+    if (XGetWindowProperty (gdk_x11_display_get_xdisplay (gdk_window_get_display (root)),
+                            gdk_x11_window_get_xid (root),
+                            search_window->net_current_desktop,
+                            0, 1, False, XA_CARDINAL,
+                            &type, &format, &items, &remaining, &data) == Success)
+    {
+        if (type == XA_CARDINAL && format == 32 && items == 1)
+            desktop = *(glong *) data;
 
-    window = gtk_widget_get_window (widget);
-    display = gdk_window_get_display (window);
+        if (data)
+            XFree (data);
+    }
 
-    XSetInputFocus (gdk_x11_display_get_xdisplay (display),
-                    gdk_x11_window_get_xid (window),
-                    RevertToPointerRoot, CurrentTime);
+    gdk_error_trap_pop_ignored ();
+
+    return desktop;
 }
 
-static void
-invenio_search_window_active_workspace_changed (WnckScreen      *screen,
-                                                WnckWorkspace   *previously_active_space,
-                                                gpointer         user_data)
+static GdkFilterReturn
+invenio_search_window_root_filter (GdkXEvent   *xevent,
+                                   GdkEvent    *event,
+                                   gpointer     user_data)
 {
     InvenioSearchWindow *search_window;
+    XEvent *xev;
+    glong desktop;
 
     search_window = (InvenioSearchWindow *) user_data;
+    xev = (XEvent *) xevent;
 
-    /* XXX Should this reset or just hide? */
-    gtk_widget_hide (search_window->window);
-    invenio_search_window_reset_search (search_window);
+    if (xev->type != PropertyNotify
+        || xev->xproperty.atom != search_window->net_current_desktop)
+        return GDK_FILTER_CONTINUE;
+
+    desktop = _get_current_desktop (search_window);
+
+    if (desktop != search_window->current_desktop)
+    {
+        search_window->current_desktop = desktop;
+        invenio_search_window_hide (search_window);
+    }
+
+    return GDK_FILTER_CONTINUE;
 }
 
 static void
-_insert_result (GtkListStore        *store,
-                GtkTreeIter         *iter,
-                InvenioCategory      category,
-                InvenioQueryResult  *result)
+_set_result (GtkListStore        *store,
+             GtkTreeIter         *iter,
+             InvenioCategory      category,
+             InvenioQueryResult  *result)
 {
     gtk_list_store_set (store, iter,
                         INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, category,
@@ -349,98 +465,616 @@ _insert_result (GtkListStore        *store,
                         -1);
 }
 
+static void
+_insert_result (GtkListStore        *store,
+                const guint          position,
+                InvenioCategory      category,
+                InvenioQueryResult  *result)
+{
+    gtk_list_store_insert_with_values (store, NULL, position,
+                                       INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, category,
+                                       INVENIO_SEARCH_RESULT_COLUMN_TITLE, invenio_query_result_get_title (result),
+                                       INVENIO_SEARCH_RESULT_COLUMN_DESCRIPTION, invenio_query_result_get_description (result),
+                                       INVENIO_SEARCH_RESULT_COLUMN_URI, invenio_query_result_get_uri (result),
+                                       INVENIO_SEARCH_RESULT_COLUMN_LOCATION, invenio_query_result_get_location (result),
+                                       -1);
+}
+
+static guint
+_category_offset (const InvenioSearchResults * const results,
+                  const InvenioCategory              category)
+{
+    InvenioCategory other;
+    guint offset = 0;
+
+    /*
+     * Rows are kept grouped by category in the configured order, so the block
+     * for a category starts after the blocks of all categories ranked before it.
+     */
+    for (other = (InvenioCategory) 0; other != INVENIO_CATEGORIES; other++)
+        if (results->rank[other] < results->rank[category])
+            offset += results->rows[other];
+
+    return offset;
+}
+
+static const gchar *
+_result_key (const InvenioQueryResult * const result)
+{
+    const gchar *uri;
+
+    uri = invenio_query_result_get_uri (result);
+
+    return uri ? uri : invenio_query_result_get_location (result);
+}
+
+static gchar *
+_row_key (GtkTreeModel  *model,
+          GtkTreeIter   *iter)
+{
+    gchar *uri, *location;
+
+    gtk_tree_model_get (model, iter,
+                        INVENIO_SEARCH_RESULT_COLUMN_URI, &uri,
+                        INVENIO_SEARCH_RESULT_COLUMN_LOCATION, &location,
+                        -1);
+
+    if (uri)
+    {
+        g_free (location);
+        return uri;
+    }
+
+    return location;
+}
+
+static gint
+_find_key (const GPtrArray * const keys,
+           const gchar * const     key,
+           const guint             start)
+{
+    guint i;
+
+    if (! key)
+        return -1;
+
+    for (i = start; i < keys->len; i++)
+        if (g_strcmp0 (g_ptr_array_index (keys, i), key) == 0)
+            return (gint) i;
+
+    return -1;
+}
+
+static void
+_update_result (GtkListStore        *store,
+                GtkTreeIter         *iter,
+                InvenioCategory      category,
+                InvenioQueryResult  *result)
+{
+    gchar *title, *description, *uri, *location;
+    InvenioCategory value;
+    gboolean changed;
+
+    gtk_tree_model_get (GTK_TREE_MODEL (store), iter,
+                        INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, &value,
+                        INVENIO_SEARCH_RESULT_COLUMN_TITLE, &title,
+                        INVENIO_SEARCH_RESULT_COLUMN_DESCRIPTION, &description,
+                        INVENIO_SEARCH_RESULT_COLUMN_URI, &uri,
+                        INVENIO_SEARCH_RESULT_COLUMN_LOCATION, &location,
+                        -1);
+
+    changed = value != category
+           || g_strcmp0 (title, invenio_query_result_get_title (result)) != 0
+           || g_strcmp0 (description, invenio_query_result_get_description (result)) != 0
+           || g_strcmp0 (uri, invenio_query_result_get_uri (result)) != 0
+           || g_strcmp0 (location, invenio_query_result_get_location (result)) != 0;
+
+    /* unchanged rows are left alone so that they are not redrawn */
+    if (changed)
+        _set_result (store, iter, category, result);
+
+    g_free (title);
+    g_free (description);
+    g_free (uri);
+    g_free (location);
+}
+
+/*
+ * Brings the block of rows rows starting at offset in line with the count
+ * results, returning the number of rows in the block afterwards.
+ */
+static guint
+_update_rows (InvenioSearchResults      *search_results,
+              const guint                offset,
+              const guint                rows,
+              InvenioQueryResult       **results,
+              const InvenioCategory     *categories,
+              const guint                count)
+{
+    GHashTable *wanted, *kept;
+    GtkTreeIter iter, target;
+    const gchar *key;
+    GPtrArray *keys;
+    gchar *row_key;
+    guint i, row;
+    gint index;
+
+    /*
+     * Rows are matched against the new results by URI so that only the minimal
+     * set of deletes, moves, inserts and changes is applied to the model.  Rows
+     * which survive keep their identity, and with it, their selection.
+     */
+    wanted = g_hash_table_new (g_str_hash, g_str_equal);
+    for (i = 0; i < count; i++)
+        if ((key = _result_key (results[i])))
+            g_hash_table_insert (wanted, (gpointer) key, results[i]);
+
+    /* deletes: rows which are gone (or duplicated) in the new results */
+    keys = g_ptr_array_new_with_free_func (g_free);
+    kept = g_hash_table_new (g_str_hash, g_str_equal);
+
+    if (rows)
+        gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (search_results->model), &iter, NULL, offset);
+
+    for (row = 0; row < rows; row++)
+    {
+        row_key = _row_key (GTK_TREE_MODEL (search_results->model), &iter);
+
+        if (row_key
+            && g_hash_table_contains (wanted, row_key)
+            && ! g_hash_table_contains (kept, row_key))
+        {
+            g_ptr_array_add (keys, row_key);
+            g_hash_table_add (kept, row_key);
+            gtk_tree_model_iter_next (GTK_TREE_MODEL (search_results->model), &iter);
+        }
+        else
+        {
+            g_free (row_key);
+            gtk_list_store_remove (search_results->model, &iter);
+            search_results->count--;
+        }
+    }
+
+    /* moves, inserts and changes: walk the new results in order */
+    for (row = 0; row < count; row++)
+    {
+        key = _result_key (results[row]);
+        index = _find_key (keys, key, row);
+
+        if (index < 0)
+        {
+            _insert_result (search_results->model, offset + row, categories[row], results[row]);
+            g_ptr_array_insert (keys, row, NULL);
+            search_results->count++;
+            continue;
+        }
+
+        gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (search_results->model), &iter, NULL,
+                                       offset + index);
+
+        if ((guint) index != row)
+        {
+            gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (search_results->model), &target, NULL,
+                                           offset + row);
+            gtk_list_store_move_before (search_results->model, &iter, &target);
+
+            row_key = g_ptr_array_index (keys, index);
+            g_ptr_array_index (keys, index) = NULL;
+            g_ptr_array_remove_index (keys, index);
+            g_ptr_array_insert (keys, row, row_key);
+        }
+
+        _update_result (search_results->model, &iter, categories[row], results[row]);
+    }
+
+    /* any remaining rows are surplus */
+    while (keys->len > row)
+    {
+        gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (search_results->model), &iter, NULL,
+                                       offset + row);
+        gtk_list_store_remove (search_results->model, &iter);
+        g_ptr_array_remove_index (keys, row);
+        search_results->count--;
+    }
+
+    g_hash_table_destroy (kept);
+    g_hash_table_destroy (wanted);
+    g_ptr_array_free (keys, TRUE);
+
+    return row;
+}
+
 static void
 invenio_search_window_update_results_for_category (InvenioSearchWindow  *search_window,
                                                    InvenioCategory       category,
                                                    const GSList         *results)
 {
+    InvenioSearchResults *search_results;
+    InvenioQueryResult **entries;
+    InvenioCategory *categories;
     const GSList *entry;
-    InvenioCategory value;
-    GtkTreeIter position;
+    guint i, count;
+
+    search_results = search_window->results;
+
+    count = g_slist_length ((GSList *) results);
+    entries = g_new (InvenioQueryResult *, count);
+    categories = g_new (InvenioCategory, count);
+
+    for (i = 0, entry = results; entry; i++, entry = g_slist_next (entry))
+    {
+        entries[i] = entry->data;
+        categories[i] = category;
+    }
+
+    search_results->rows[category] =
+        _update_rows (search_results, _category_offset (search_results, category),
+                      search_results->rows[category], entries, categories, count);
+
+    g_free (entries);
+    g_free (categories);
+}
+
+static void
+invenio_search_window_update_best_matches (InvenioSearchWindow *search_window,
+                                           const guint          pending)
+{
+    InvenioSearchResults *search_results;
+    InvenioQueryResult **entries;
+    InvenioCategory *categories;
+    InvenioCategory category;
+    InvenioRanking *ranking;
+    gboolean rebuild = FALSE;
+    guint count;
+
+    search_results = search_window->results;
+    ranking = search_results->ranking;
+
+    /*
+     * Categories are offered to the ranking as they complete, so that only the
+     * new rows are scored.  A category which delivers again (more results, or
+     * tracker's replacing the history's) may have evicted rows of other
+     * categories, so the ranking is then rebuilt from all of them.
+     */
+    for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+        if ((pending & (1 << category)) && invenio_ranking_has_category (ranking, category))
+            rebuild = TRUE;
+
+    if (rebuild)
+        invenio_ranking_reset (ranking);
+
+    for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+        if (rebuild || (pending & (1 << category)))
+            invenio_ranking_offer (ranking, category,
+                                   invenio_query_get_results_for_category (search_window->query,
+                                                                           category));
+
+    entries = g_new (InvenioQueryResult *, search_results->best_matches);
+    categories = g_new (InvenioCategory, search_results->best_matches);
+
+    count = invenio_ranking_get_results (ranking, entries, categories);
+
+    /* the best matches are a single block spanning the whole model */
+    _update_rows (search_results, 0, search_results->count, entries, categories, count);
+    memset (search_results->rows, 0, sizeof (search_results->rows));
+
+    g_free (entries);
+    g_free (categories);
+}
+
+static void
+invenio_search_window_clear_results_for_category (InvenioSearchWindow   *search_window,
+                                                  InvenioCategory        category)
+{
+    InvenioSearchResults *search_results;
     GtkTreeIter iter;
-    gboolean valid;
 
-    valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (search_window->results->model), &iter);
+    search_results = search_window->results;
+
+    if (! search_results->rows[category])
+        return;
+
+    gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (search_results->model), &iter, NULL,
+                                   _category_offset (search_results, category));
 
-    while (valid)
+    for (; search_results->rows[category]; search_results->rows[category]--)
     {
-        gtk_tree_model_get (GTK_TREE_MODEL (search_window->results->model), &iter,
-                            INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, &value, -1);
+        gtk_list_store_remove (search_results->model, &iter);
+        search_results->count--;
+    }
+}
+
+static GIcon *
+_resolve_icon (const gchar * const uri)
+{
+    GFile *file;
+    gchar *id;
+    GFileInfo *info;
+    GIcon *icon = NULL;
+    GError *error = NULL;
+
+    if (_uri_is_executable (uri))
+    {
+        /* TODO Try to get the application icon */
+        return g_themed_icon_new (GTK_STOCK_EXECUTE);
+    }
+
+    file = g_file_new_for_uri (uri);
 
-        if (value == category)
+    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_ICON,
+                              G_FILE_QUERY_INFO_NONE, NULL, &error);
+    if (error)
+    {
+        g_warning ("Could not query file info for uri '%s': %s",
+                   uri, error->message);
+        g_error_free (error);
+    }
+    else
+    {
+        /*
+         * The icon is owned by the info and will be unref'ed when the info
+         * is unref'ed.  We need to copy the icon in order to hold a valid
+         * icon.
+         */
+        if ((id = g_icon_to_string (g_file_info_get_icon (info))))
         {
-            for (entry = results; entry; entry = g_slist_next (entry))
+            icon = g_icon_new_for_string (id, &error);
+            if (error)
             {
-                _insert_result (search_window->results->model, &iter, category, entry->data);
+                g_warning ("Could not create GIcon for uri '%s': %s",
+                           uri, error->message);
+                g_error_free (error);
+            }
 
-                valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (search_window->results->model), &iter);
-                if (! valid)
-                    break;
+            g_free (id);
+        }
+    }
 
-                gtk_tree_model_get (GTK_TREE_MODEL (search_window->results->model), &iter,
-                                    INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, &value, -1);
-                if (value != category)
-                    break;
-            }
+    if (info)
+        g_object_unref (info);
 
-            while ((entry = g_slist_next (entry)))
-            {
-                if (valid)
-                    gtk_list_store_insert_before (search_window->results->model, &position, &iter);
-                else
-                    gtk_list_store_append (search_window->results->model, &position);
+    g_object_unref (file);
 
-                _insert_result (search_window->results->model, &position, category, entry->data);
-                search_window->results->count++;
-            }
+    return icon;
+}
 
-            while (valid)
-            {
-                gtk_tree_model_get (GTK_TREE_MODEL (search_window->results->model), &iter,
-                                    INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, &value, -1);
-                if (value != category)
-                    break;
+static GIcon *
+_lookup_icon (InvenioSearchWindow   *search_window,
+              const gchar * const    uri)
+{
+    gpointer icon;
 
-                valid = gtk_list_store_remove (search_window->results->model, &iter);
-                search_window->results->count--;
-            }
+    if (! uri)
+        return NULL;
 
-            return;
-        }
+    if (g_hash_table_lookup_extended (search_window->icons, uri, NULL, &icon))
+        return icon;
+
+    if (g_hash_table_size (search_window->icons) >= INVENIO_SEARCH_WINDOW_ICON_CACHE_SIZE)
+        g_hash_table_remove_all (search_window->icons);
+
+    icon = _resolve_icon (uri);
+    g_hash_table_insert (search_window->icons, g_strdup (uri), icon);
 
-        valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (search_window->results->model), &iter);
+    return icon;
+}
+
+static void
+invenio_search_window_suggest (InvenioSearchWindow *search_window)
+{
+    const InvenioConfigurationSnapshot *configuration;
+    GSList *results[INVENIO_CATEGORIES];
+    InvenioCategory category;
+    const GSList *entry;
+
+    /* suggestions only stand in for an empty search */
+    if (search_window->query)
+        return;
+
+    configuration = invenio_configuration_get_snapshot ();
+
+    /*
+     * The most launched results come from the history in memory, and their
+     * icons are resolved here, so that they are on screen as soon as the
+     * window maps without waiting on tracker or the disk.
+     */
+    invenio_history_get_top (configuration->history_suggestions, results);
+
+    for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+    {
+        for (entry = results[category]; entry; entry = entry->next)
+            _lookup_icon (search_window, invenio_query_result_get_uri (entry->data));
+
+        if (results[category] && configuration->category_enabled[category])
+            invenio_search_window_update_results_for_category (search_window, category, results[category]);
+        else
+            invenio_search_window_clear_results_for_category (search_window, category);
+
+        g_slist_foreach (results[category], (GFunc) invenio_query_result_free, NULL);
+        g_slist_free (results[category]);
     }
+}
 
-    for (entry = results; entry; entry = g_slist_next (entry))
+static gboolean
+invenio_search_window_suggest_idle (gpointer user_data)
+{
+    InvenioSearchWindow *search_window;
+
+    search_window = (InvenioSearchWindow *) user_data;
+
+    search_window->suggest_id = 0;
+    invenio_search_window_suggest (search_window);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_find_result (GtkTreeModel          *model,
+              const InvenioCategory  category,
+              const gchar * const    uri,
+              GtkTreeIter           *iter)
+{
+    InvenioCategory value;
+    gboolean valid, found;
+    gchar *entry;
+
+    for (valid = gtk_tree_model_get_iter_first (model, iter);
+         valid;
+         valid = gtk_tree_model_iter_next (model, iter))
     {
-        gtk_list_store_append (search_window->results->model, &iter);
-        _insert_result (search_window->results->model, &iter, category, entry->data);
-        search_window->results->count++;
+        gtk_tree_model_get (model, iter,
+                            INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, &value,
+                            INVENIO_SEARCH_RESULT_COLUMN_URI, &entry,
+                            -1);
+
+        found = (value == category && g_strcmp0 (entry, uri) == 0);
+        g_free (entry);
+
+        if (found)
+            return TRUE;
     }
+
+    return FALSE;
 }
 
 static void
-invenio_search_window_clear_results_for_category (InvenioSearchWindow   *search_window,
-                                                  InvenioCategory        category)
+invenio_search_window_flush_results (InvenioSearchWindow *search_window)
 {
-    InvenioCategory value;
+    InvenioCategory category, selected_category = INVENIO_CATEGORIES;
+    GtkTreeSelection *selection;
+    const GSList *results;
+    gchar *selected_uri = NULL;
+    GtkTreeModel *model;
     GtkTreeIter iter;
-    gboolean valid;
+    gboolean detach;
+    guint pending;
+
+    pending = search_window->results->pending;
+    search_window->results->pending = 0;
 
-    valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (search_window->results->model), &iter);
+    if (! pending || ! search_window->query)
+        return;
+
+    model = GTK_TREE_MODEL (search_window->results->model);
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (search_window->results->view));
 
-    while (valid)
+    if (gtk_tree_selection_get_selected (selection, NULL, &iter))
+        gtk_tree_model_get (model, &iter,
+                            INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, &selected_category,
+                            INVENIO_SEARCH_RESULT_COLUMN_URI, &selected_uri,
+                            -1);
+
+    /*
+     * When populating an empty model, detach it while applying the batch so
+     * that the view does not process the row signals for each individual
+     * insert.  The view picks up the final state once when the model is
+     * re-attached and lays out in the layout phase of the current frame.
+     * Otherwise, the updates are minimal diffs and the view stays attached so
+     * that only the affected rows are redrawn.
+     */
+    detach = (search_window->results->count == 0);
+
+    if (detach)
     {
-        gtk_tree_model_get (GTK_TREE_MODEL (search_window->results->model), &iter,
-                            INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, &value, -1);
+        g_object_ref (model);
+        gtk_tree_view_set_model (GTK_TREE_VIEW (search_window->results->view), NULL);
+    }
 
-        if (value == category)
+    if (search_window->results->ranking)
+    {
+        invenio_search_window_update_best_matches (search_window, pending);
+    }
+    else
+    {
+        for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
         {
-            valid = gtk_list_store_remove (search_window->results->model, &iter);
-            search_window->results->count--;
+            if (! (pending & (1 << category)))
+                continue;
+
+            results = invenio_query_get_results_for_category (search_window->query, category);
+
+            if (results)
+                invenio_search_window_update_results_for_category (search_window, category, results);
+            else
+                invenio_search_window_clear_results_for_category (search_window, category);
         }
-        else
-            valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (search_window->results->model), &iter);
+    }
+
+    if (detach)
+    {
+        gtk_tree_view_set_model (GTK_TREE_VIEW (search_window->results->view), model);
+        g_object_unref (model);
+    }
+    else
+    {
+        /* the category headers reflect whether more results are available */
+        gtk_widget_queue_draw (search_window->results->view);
+    }
+
+    if (selected_uri)
+    {
+        if (! gtk_tree_selection_get_selected (selection, NULL, NULL)
+            && _find_result (model, selected_category, selected_uri, &iter))
+            gtk_tree_selection_select_iter (selection, &iter);
+
+        g_free (selected_uri);
+    }
+}
+
+static gboolean
+invenio_search_window_flush_tick (GtkWidget     *widget,
+                                  GdkFrameClock *frame_clock,
+                                  gpointer       user_data)
+{
+    InvenioSearchWindow *search_window;
+
+    search_window = (InvenioSearchWindow *) user_data;
+
+    search_window->results->flush_id = 0;
+    invenio_search_window_flush_results (search_window);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+invenio_search_window_flush_idle (gpointer user_data)
+{
+    InvenioSearchWindow *search_window;
+
+    search_window = (InvenioSearchWindow *) user_data;
+
+    search_window->results->flush_id = 0;
+    invenio_search_window_flush_results (search_window);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+invenio_search_window_queue_flush (InvenioSearchWindow *search_window)
+{
+    if (search_window->results->flush_id)
+        return;
+
+    /*
+     * While the window is visible, completions are applied in the update phase
+     * of the next frame so that any number of categories results in a single
+     * layout and paint.  A hidden window has no frame clock running, so fall
+     * back to an idle.
+     */
+    if (gtk_widget_get_mapped (search_window->window))
+    {
+        search_window->results->flush_on_tick = TRUE;
+        search_window->results->flush_id =
+            gtk_widget_add_tick_callback (search_window->window,
+                                          invenio_search_window_flush_tick,
+                                          search_window, NULL);
+    }
+    else
+    {
+        search_window->results->flush_on_tick = FALSE;
+        search_window->results->flush_id =
+            g_idle_add (invenio_search_window_flush_idle, search_window);
     }
 }
 
@@ -450,12 +1084,18 @@ invenio_search_window_update_results_for_query (InvenioQuery            *query,
                                                 GError                  *error,
                                                 gpointer                 user_data)
 {
-    const GSList *results;
     InvenioSearchWindow *search_window;
 
     search_window = (InvenioSearchWindow *) user_data;
 
-    if (error)
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT))
+    {
+        /* drop the rows of the previous search rather than keep stale results */
+        g_debug ("Query for category '%s' timed out",
+                 invenio_category_to_string (category));
+        g_error_free (error);
+    }
+    else if (error)
     {
         g_critical ("Failed to execute query for category '%s': %s",
                     invenio_category_to_string (category),
@@ -464,12 +1104,51 @@ invenio_search_window_update_results_for_query (InvenioQuery            *query,
         return;
     }
 
-    results = invenio_query_get_results_for_category (query, category);
+    search_window->results->pending |= (1 << category);
+    invenio_search_window_queue_flush (search_window);
+}
 
-    if (results)
-        invenio_search_window_update_results_for_category (search_window, category, results);
-    else
-        invenio_search_window_clear_results_for_category (search_window, category);
+static void
+invenio_search_window_search (InvenioSearchWindow   *search_window,
+                              const gchar * const    search)
+{
+    InvenioCategory category;
+    guint categories;
+
+    if (search_window->query)
+    {
+        invenio_query_free (search_window->query);
+        search_window->query = NULL;
+    }
+
+    invenio_search_window_cancel_flush (search_window);
+    invenio_search_window_free_ranking (search_window);
+
+    search_window->query = invenio_query_new (search);
+    search_window->query_time = g_get_monotonic_time ();
+
+    search_window->results->best_matches = invenio_configuration_get_snapshot ()->best_matches;
+    if (search_window->results->best_matches)
+        search_window->results->ranking =
+            invenio_ranking_new (invenio_query_get_keywords (search_window->query),
+                                 search_window->results->best_matches, NULL, NULL);
+
+    /*
+     * Categories which the search excludes never report back, so they are
+     * flushed as empty now rather than keep the previous search's rows.
+     */
+    categories = invenio_query_get_categories (search_window->query);
+
+    for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+        if (! (categories & (1 << category)))
+            search_window->results->pending |= (1 << category);
+
+    if (search_window->results->pending)
+        invenio_search_window_queue_flush (search_window);
+
+    invenio_query_execute_async (search_window->query,
+                                 invenio_search_window_update_results_for_query,
+                                 search_window);
 }
 
 static void
@@ -491,19 +1170,110 @@ invenio_search_window_entry_changed (GtkEditable    *editable,
         return;
     }
 
+    gtk_entry_set_icon_from_stock (GTK_ENTRY (search_window->entry),
+                                   GTK_ENTRY_ICON_SECONDARY, GTK_STOCK_CLEAR);
+
+    invenio_search_window_search (search_window, search);
+}
+
+static void
+invenio_search_window_configuration_changed (const InvenioConfigurationChange   changes,
+                                             gpointer                           user_data)
+{
+    const InvenioConfigurationSnapshot *configuration;
+    InvenioSearchWindow *search_window;
+    InvenioCategory category;
+    guint i;
+
+    search_window = (InvenioSearchWindow *) user_data;
+    configuration = invenio_configuration_get_snapshot ();
+
+    if (! (changes & (INVENIO_CONFIGURATION_CHANGE_SEARCH_CATEGORIES |
+                      INVENIO_CONFIGURATION_CHANGE_CATEGORY_ORDER |
+                      INVENIO_CONFIGURATION_CHANGE_SEARCH |
+                      INVENIO_CONFIGURATION_CHANGE_HISTORY)))
+        return;
+
+    invenio_search_window_cancel_flush (search_window);
+
+    if (search_window->query
+        && (search_window->results->ranking != NULL) != (configuration->best_matches != 0))
+    {
+        /* switching between grouped results and best matches starts over */
+        gtk_list_store_clear (search_window->results->model);
+        memset (search_window->results->rows, 0, sizeof (search_window->results->rows));
+        search_window->results->count = 0;
+    }
+
+    if (changes & INVENIO_CONFIGURATION_CHANGE_CATEGORY_ORDER)
+    {
+        /* rows are placed by rank, so a new order starts from an empty model */
+        for (i = 0; i < INVENIO_CATEGORIES; i++)
+            search_window->results->rank[configuration->category_order[i]] = i;
+
+        gtk_list_store_clear (search_window->results->model);
+        memset (search_window->results->rows, 0, sizeof (search_window->results->rows));
+        search_window->results->count = 0;
+    }
+    else
+    {
+        for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+            if (! configuration->category_enabled[category])
+                invenio_search_window_clear_results_for_category (search_window, category);
+    }
+
+    /* re-issue the open search; its results are diffed in as they arrive */
     if (search_window->query)
+        invenio_search_window_search (search_window,
+                                      gtk_entry_get_text (GTK_ENTRY (search_window->entry)));
+    else
+        invenio_search_window_suggest (search_window);
+}
+
+static gboolean
+invenio_search_window_map (GtkWidget    *widget,
+                           GdkEvent     *event,
+                           gpointer      user_data)
+{
+    InvenioSearchWindow *search_window;
+    GdkDisplay *display;
+    GdkWindow  *window;
+    gint64 age;
+
+    search_window = (InvenioSearchWindow *) user_data;
+
+    if (search_window->summon_time)
     {
-        invenio_query_free (search_window->query);
-        search_window->query = NULL;
+        g_debug ("search window mapped %.3f ms after activation",
+                 (g_get_monotonic_time () - search_window->summon_time) / 1000.0);
+        search_window->summon_time = 0;
     }
 
-    gtk_entry_set_icon_from_stock (GTK_ENTRY (search_window->entry),
-                                   GTK_ENTRY_ICON_SECONDARY, GTK_STOCK_CLEAR);
+    window = gtk_widget_get_window (widget);
+    display = gdk_window_get_display (window);
 
-    search_window->query = invenio_query_new (search);
-    invenio_query_execute_async (search_window->query,
-                                 invenio_search_window_update_results_for_query,
-                                 search_window);
+    XSetInputFocus (gdk_x11_display_get_xdisplay (display),
+                    gdk_x11_window_get_xid (window),
+                    RevertToPointerRoot, CurrentTime);
+
+    /*
+     * A warm search window still holds the previous search.  Present it as is,
+     * with the text selected so that typing replaces it, and refresh the
+     * results in the background if they are older than the configured
+     * threshold.
+     */
+    gtk_editable_select_region (GTK_EDITABLE (search_window->entry), 0, -1);
+
+    if (search_window->query)
+    {
+        age = g_get_monotonic_time () - search_window->query_time;
+
+        if (age > (gint64) invenio_configuration_get_snapshot ()->staleness_threshold * G_USEC_PER_SEC)
+            invenio_search_window_search (search_window,
+                                          gtk_entry_get_text (GTK_ENTRY (search_window->entry)));
+    }
+
+    return FALSE;
 }
 
 static void
@@ -558,14 +1328,57 @@ _category_cell_data (GtkTreeViewColumn  *tree_column,
         }
     }
 
+    /* a header with more results to show is underlined, click it to show them */
     g_object_set (cell,
                   "text", invenio_category_to_string (category),
+                  "underline", (visible && search_window->query && ! search_window->results->ranking
+                                && invenio_query_has_more (search_window->query, category))
+                               ? PANGO_UNDERLINE_SINGLE : PANGO_UNDERLINE_NONE,
                   "visible", visible,
                   NULL);
 
     gtk_tree_path_free (path);
 }
 
+static gboolean
+invenio_search_window_results_button_press (GtkWidget      *widget,
+                                            GdkEventButton *event,
+                                            gpointer        user_data)
+{
+    InvenioSearchWindow *search_window;
+    GtkTreeViewColumn *column;
+    InvenioCategory category;
+    gboolean handled = FALSE;
+    GtkTreePath *path;
+    GtkTreeIter iter;
+
+    search_window = (InvenioSearchWindow *) user_data;
+
+    /* the best matches are not grouped, so there are no category headers */
+    if (event->type != GDK_BUTTON_PRESS || event->button != 1
+        || ! search_window->query || search_window->results->ranking)
+        return FALSE;
+
+    if (! gtk_tree_view_get_path_at_pos (GTK_TREE_VIEW (widget), event->x, event->y,
+                                         &path, &column, NULL, NULL))
+        return FALSE;
+
+    /* only the first row of a category displays its header */
+    if (column == search_window->results->category_column
+        && gtk_tree_model_get_iter (GTK_TREE_MODEL (search_window->results->model), &iter, path))
+    {
+        gtk_tree_model_get (GTK_TREE_MODEL (search_window->results->model), &iter,
+                            INVENIO_SEARCH_RESULT_COLUMN_CATEGORY, &category, -1);
+
+        if ((guint) gtk_tree_path_get_indices (path)[0] == _category_offset (search_window->results, category))
+            handled = invenio_query_fetch_more (search_window->query, category);
+    }
+
+    gtk_tree_path_free (path);
+
+    return handled;
+}
+
 static void
 _icon_cell_data (GtkTreeViewColumn  *tree_column,
                  GtkCellRenderer    *cell,
@@ -573,11 +1386,7 @@ _icon_cell_data (GtkTreeViewColumn  *tree_column,
                  GtkTreeIter        *iter,
                  gpointer            data)
 {
-    GFile *file;
-    gchar *id, *uri;
-    GFileInfo *info;
-    GIcon *icon = NULL;
-    GError *error = NULL;
+    gchar *uri;
     InvenioSearchWindow *search_window;
 
     search_window = (InvenioSearchWindow *) data;
@@ -585,56 +1394,19 @@ _icon_cell_data (GtkTreeViewColumn  *tree_column,
     gtk_tree_model_get (GTK_TREE_MODEL (search_window->results->model), iter,
                         INVENIO_SEARCH_RESULT_COLUMN_URI, &uri, -1);
 
-    if (_uri_is_executable (uri))
-    {
-        /* TODO Try to get the application icon */
-        icon = g_themed_icon_new (GTK_STOCK_EXECUTE);
-    }
-    else
-    {
-        file = g_file_new_for_uri (uri);
-
-        info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_ICON,
-                                  G_FILE_QUERY_INFO_NONE, NULL, &error);
-        if (error)
-        {
-            g_warning ("Could not query file info for uri '%s': %s",
-                       uri, error->message);
-            g_error_free (error);
-        }
-        else
-        {
-            /*
-             * The icon is owned by the info and will be unref'ed when the info
-             * is unref'ed.  We need to copy the icon in order to hold a valid
-             * icon.
-             */
-            if ((id = g_icon_to_string (g_file_info_get_icon (info))))
-            {
-                icon = g_icon_new_for_string (id, &error);
-                if (error)
-                {
-                    g_warning ("Could not create GIcon for uri '%s': %s",
-                               uri, error->message);
-                    g_error_free (error);
-                }
-
-                g_free (id);
-            }
-        }
-
-        if (info)
-            g_object_unref (info);
-
-        g_object_unref (file);
-    }
+    g_object_set (G_OBJECT (cell),
+                  "gicon", _lookup_icon (search_window, uri),
+                  "visible", TRUE,
+                  NULL);
 
-    g_object_set (G_OBJECT (cell), "gicon", icon, "visible", TRUE, NULL);
+    g_free (uri);
+}
 
+static void
+_unref_icon (gpointer icon)
+{
     if (icon)
         g_object_unref (icon);
-
-    g_free (uri);
 }
 
 static InvenioSearchWindow *
@@ -643,8 +1415,10 @@ invenio_search_window_create (void)
     InvenioSearchWindow *search_window;
     GtkWidget *label, *hbox, *vbox;
     GtkTreeViewColumn *column;
+    const InvenioConfigurationSnapshot *configuration;
     GtkCellRenderer *cell;
-    WnckScreen *screen;
+    GdkWindow *root;
+    guint i;
 
     search_window = g_new0 (InvenioSearchWindow, 1);
 
@@ -670,10 +1444,19 @@ invenio_search_window_create (void)
                       G_CALLBACK (invenio_search_window_map),
                       search_window);
 
-    screen = wnck_screen_get_default ();
-    g_signal_connect (G_OBJECT (screen), "active-workspace-changed",
-                      G_CALLBACK (invenio_search_window_active_workspace_changed),
-                      search_window);
+    /*
+     * Hide when the active workspace changes.  Rather than having libwnck track
+     * every window and workspace, watch the window manager's
+     * _NET_CURRENT_DESKTOP property on the root window.
+     */
+    root = gdk_get_default_root_window ();
+    search_window->net_current_desktop =
+        gdk_x11_get_xatom_by_name_for_display (gdk_window_get_display (root),
+                                               "_NET_CURRENT_DESKTOP");
+    search_window->current_desktop = _get_current_desktop (search_window);
+
+    gdk_window_set_events (root, gdk_window_get_events (root) | GDK_PROPERTY_CHANGE_MASK);
+    gdk_window_add_filter (root, invenio_search_window_root_filter, search_window);
 
     /* label */
     label = gtk_label_new ("Search: ");
@@ -695,6 +1478,8 @@ invenio_search_window_create (void)
 
     /* results */
     search_window->results = g_new0 (InvenioSearchResults, 1);
+    search_window->icons = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                  g_free, _unref_icon);
 
     search_window->results->model =
         gtk_list_store_new (INVENIO_SEARCH_RESULT_COLUMNS,
@@ -704,9 +1489,17 @@ invenio_search_window_create (void)
                             COLUMN_TYPE(INVENIO_SEARCH_RESULT_COLUMN_DESCRIPTION),
                             COLUMN_TYPE(INVENIO_SEARCH_RESULT_COLUMN_URI),
                             COLUMN_TYPE(INVENIO_SEARCH_RESULT_COLUMN_LOCATION));
-    gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (search_window->results->model),
-                                          INVENIO_SEARCH_RESULT_COLUMN_CATEGORY,
-                                          GTK_SORT_ASCENDING);
+
+    /*
+     * Rows are inserted directly at their final position (see
+     * _category_offset), so the model is deliberately left unsorted.
+     */
+    configuration = invenio_configuration_get_snapshot ();
+    for (i = 0; i < INVENIO_CATEGORIES; i++)
+        search_window->results->rank[configuration->category_order[i]] = i;
+
+    invenio_configuration_add_notify (invenio_search_window_configuration_changed,
+                                      search_window);
 
     search_window->results->view =
         gtk_tree_view_new_with_model (GTK_TREE_MODEL (search_window->results->model));
@@ -715,6 +1508,9 @@ invenio_search_window_create (void)
     gtk_tree_view_set_tooltip_column (GTK_TREE_VIEW (search_window->results->view),
                                       INVENIO_SEARCH_RESULT_COLUMN_DESCRIPTION);
     gtk_widget_set_can_focus (GTK_WIDGET (search_window->results->view), FALSE);
+    g_signal_connect (G_OBJECT (search_window->results->view), "button-press-event",
+                      G_CALLBACK (invenio_search_window_results_button_press),
+                      search_window);
 
     /* Column: Category */
     column = gtk_tree_view_column_new ();
@@ -725,6 +1521,7 @@ invenio_search_window_create (void)
     gtk_tree_view_column_set_cell_data_func (column, cell, _category_cell_data, search_window, NULL);
 
     gtk_tree_view_append_column (GTK_TREE_VIEW (search_window->results->view), column);
+    search_window->results->category_column = column;
 
     /* Column: Icon + Title */
     column = gtk_tree_view_column_new ();
@@ -758,13 +1555,37 @@ invenio_search_window_create (void)
 GtkWidget *
 invenio_search_window_get_default (void)
 {
-    static InvenioSearchWindow *search_window = NULL;
+    if (! search_window_default)
+        search_window_default = invenio_search_window_create ();
 
-    if (search_window)
-        return search_window->window;
+    return search_window_default->window;
+}
 
-    search_window = invenio_search_window_create ();
+void
+invenio_search_window_present (const guint32 timestamp,
+                               const gint64  activation_time)
+{
+    InvenioSearchWindow *search_window;
 
-    return search_window->window;
-}
+    invenio_search_window_get_default ();
+    search_window = search_window_default;
+
+    if (gtk_widget_get_mapped (search_window->window))
+    {
+        gtk_window_present_with_time (GTK_WINDOW (search_window->window), timestamp);
+        return;
+    }
+
+    search_window->summon_time = activation_time;
+    gtk_window_present_with_time (GTK_WINDOW (search_window->window), timestamp);
 
+    /*
+     * The suggestions are refreshed when the window hides, so they are usually
+     * on screen already.  Anything since (the history loading after the window
+     * was created, say) is picked up once the window is up, off the hotkey path.
+     */
+    if (! search_window->query && ! search_window->suggest_id)
+        search_window->suggest_id =
+            g_idle_add_full (G_PRIORITY_LOW, invenio_search_window_suggest_idle,
+                             search_window, NULL);
+}
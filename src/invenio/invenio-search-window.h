@@ -36,5 +36,9 @@
 GtkWidget *
 invenio_search_window_get_default (void);
 
+void
+invenio_search_window_present (const guint32 timestamp,
+                               const gint64  activation_time);
+
 #endif
 
@@ -0,0 +1,115 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#include "invenio-startup.h"
+
+typedef struct InvenioStartupTiming
+{
+    gint64      begin;
+    gint64      end;
+} InvenioStartupTiming;
+
+static const gchar * const InvenioStartupStageString[INVENIO_STARTUP_STAGES] =
+{
+    [INVENIO_STARTUP_STAGE_TOOLKIT]         = "toolkit",
+    [INVENIO_STARTUP_STAGE_CONFIGURATION]   = "configuration",
+    [INVENIO_STARTUP_STAGE_HOTKEY]          = "hotkey",
+    [INVENIO_STARTUP_STAGE_STATUS_ICON]     = "status icon",
+    [INVENIO_STARTUP_STAGE_SEARCH_WINDOW]   = "search window",
+    [INVENIO_STARTUP_STAGE_HISTORY]         = "history",
+    [INVENIO_STARTUP_STAGE_TRACKER_CLIENT]  = "tracker client",
+    [INVENIO_STARTUP_STAGE_TRACKER_WARM_UP] = "tracker warm-up",
+};
+
+
+static struct
+{
+    gint64                  epoch;
+    gboolean                report;
+    guint                   completed;
+    InvenioStartupTiming    stages[INVENIO_STARTUP_STAGES];
+} startup;
+
+
+static void
+_report (void)
+{
+    InvenioStartupStage stage;
+    gint64 last = 0;
+
+    g_print ("startup report (ms):\n");
+    g_print ("  %-16s %10s %10s\n", "stage", "start", "duration");
+
+    for (stage = (InvenioStartupStage) 0; stage != INVENIO_STARTUP_STAGES; stage++)
+    {
+        g_print ("  %-16s %10.3f %10.3f\n",
+                 InvenioStartupStageString[stage],
+                 (startup.stages[stage].begin - startup.epoch) / 1000.0,
+                 (startup.stages[stage].end - startup.stages[stage].begin) / 1000.0);
+
+        last = MAX (last, startup.stages[stage].end);
+    }
+
+    g_print ("  %-16s %10s %10.3f\n", "total", "", (last - startup.epoch) / 1000.0);
+}
+
+void
+invenio_startup_init (void)
+{
+    startup.epoch = g_get_monotonic_time ();
+}
+
+void
+invenio_startup_set_report (const gboolean report)
+{
+    startup.report = report;
+}
+
+void
+invenio_startup_stage_begin (const InvenioStartupStage stage)
+{
+    g_return_if_fail (stage < INVENIO_STARTUP_STAGES);
+
+    startup.stages[stage].begin = g_get_monotonic_time ();
+}
+
+void
+invenio_startup_stage_end (const InvenioStartupStage stage)
+{
+    g_return_if_fail (stage < INVENIO_STARTUP_STAGES);
+
+    if (startup.stages[stage].end)
+        return;
+
+    startup.stages[stage].end = g_get_monotonic_time ();
+
+    if (++startup.completed == INVENIO_STARTUP_STAGES && startup.report)
+        _report ();
+}
@@ -0,0 +1,61 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#ifndef __INVENIO_STARTUP_H__
+#define __INVENIO_STARTUP_H__
+
+#include <glib.h>
+
+typedef enum InvenioStartupStage
+{
+    INVENIO_STARTUP_STAGE_TOOLKIT,
+    INVENIO_STARTUP_STAGE_CONFIGURATION,
+    INVENIO_STARTUP_STAGE_HOTKEY,
+    INVENIO_STARTUP_STAGE_STATUS_ICON,
+    INVENIO_STARTUP_STAGE_SEARCH_WINDOW,
+    INVENIO_STARTUP_STAGE_HISTORY,
+    INVENIO_STARTUP_STAGE_TRACKER_CLIENT,
+    INVENIO_STARTUP_STAGE_TRACKER_WARM_UP,
+    INVENIO_STARTUP_STAGES,
+} InvenioStartupStage;
+
+void
+invenio_startup_init (void);
+
+void
+invenio_startup_set_report (const gboolean report);
+
+void
+invenio_startup_stage_begin (const InvenioStartupStage stage);
+
+void
+invenio_startup_stage_end (const InvenioStartupStage stage);
+
+#endif
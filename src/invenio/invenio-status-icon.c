@@ -31,9 +31,13 @@
 #include <gtk/gtk.h>
 
 #include "lash/lash.h"
+#include "invenio-query.h"
+#include "invenio-history.h"
+#include "invenio-startup.h"
 #include "invenio-status-icon.h"
 #include "invenio-search-window.h"
 #include "libinvenio/invenio-configuration.h"
+#include "libinvenio/invenio-remote.h"
 
 typedef struct InvenioStatusIcon
 {
@@ -43,52 +47,192 @@ typedef struct InvenioStatusIcon
     GtkWidget       *search_window;
 
     LashKeyBinding  *key_binding;
+
+    /* cached placement of the status icon, used to position the search window */
+    struct
+    {
+        gboolean         valid;
+        GdkRectangle     area;
+        GtkOrientation   orientation;
+        GdkRectangle     monitor;
+        guint            refresh_id;
+    } geometry;
+
+    /* categories enabled when the index was last warmed up, as a mask */
+    guint            categories;
 } InvenioStatusIcon;
 
 
 static InvenioStatusIcon *icon;
 
 
+static guint
+_enabled_categories (void)
+{
+    const InvenioConfigurationSnapshot *configuration;
+    InvenioCategory category;
+    guint categories = 0;
+
+    configuration = invenio_configuration_get_snapshot ();
+
+    for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+        if (configuration->category_enabled[category])
+            categories |= (1 << category);
+
+    return categories;
+}
+
 static void
-_icon_activate (GtkStatusIcon   *status_icon,
-                gpointer         user_data)
+_update_geometry (InvenioStatusIcon *icon)
 {
-    GtkWidget *menu;
     GdkScreen *screen;
-    InvenioStatusIcon *icon;
-    gint window_width, window_height;
-    GdkRectangle geometry;
-    gint menu_x, menu_y;
-    gboolean pushed_in;
     gint monitor;
-    gint x, y;
 
-    g_return_if_fail (status_icon);
-    g_return_if_fail (GTK_IS_STATUS_ICON (status_icon));
-    g_return_if_fail (user_data);
+    if (! gtk_status_icon_get_geometry (icon->status_icon, &screen,
+                                        &icon->geometry.area,
+                                        &icon->geometry.orientation))
+    {
+        screen = gtk_status_icon_get_screen (icon->status_icon);
+        icon->geometry.area.x = icon->geometry.area.y = 0;
+        icon->geometry.area.width = icon->geometry.area.height = 0;
+        icon->geometry.orientation = GTK_ORIENTATION_HORIZONTAL;
+    }
+
+    monitor = gdk_screen_get_monitor_at_point (screen,
+                                               icon->geometry.area.x,
+                                               icon->geometry.area.y);
+    gdk_screen_get_monitor_geometry (screen, monitor, &icon->geometry.monitor);
+
+    icon->geometry.valid = TRUE;
+}
+
+static void
+_invalidate_geometry (InvenioStatusIcon *icon)
+{
+    icon->geometry.valid = FALSE;
+}
+
+static gboolean
+_refresh_geometry (gpointer user_data)
+{
+    InvenioStatusIcon *icon;
 
     icon = (InvenioStatusIcon *) user_data;
 
-    menu = gtk_menu_new ();
-    gtk_status_icon_position_menu (GTK_MENU (menu),
-                                   &menu_x, &menu_y, &pushed_in,
-                                   status_icon);
+    icon->geometry.refresh_id = 0;
+    _update_geometry (icon);
 
-    screen = gtk_status_icon_get_screen (status_icon);
-    monitor = gdk_screen_get_monitor_at_point (screen, menu_x, menu_y);
-    gdk_screen_get_monitor_geometry (screen, monitor, &geometry);
+    return G_SOURCE_REMOVE;
+}
 
-    gtk_window_get_size (GTK_WINDOW (icon->search_window),
-                         &window_width, &window_height);
+static void
+_position_search_window (InvenioStatusIcon  *icon,
+                         gint               *x,
+                         gint               *y)
+{
+    const GdkRectangle *area, *monitor;
+    gint width, height;
+
+    area = &icon->geometry.area;
+    monitor = &icon->geometry.monitor;
+
+    gtk_window_get_size (GTK_WINDOW (icon->search_window), &width, &height);
+
+    /* place the window next to the icon, on the side facing into the monitor */
+    if (icon->geometry.orientation == GTK_ORIENTATION_VERTICAL)
+    {
+        if (area->x + area->width + width <= monitor->x + monitor->width)
+            *x = area->x + area->width;
+        else
+            *x = area->x - width;
+        *y = area->y;
+    }
+    else
+    {
+        *x = area->x;
+        if (area->y + area->height + height <= monitor->y + monitor->height)
+            *y = area->y + area->height;
+        else
+            *y = area->y - height;
+    }
 
-    x = CLAMP (menu_x, 0, geometry.width - window_width);
-    y = CLAMP (menu_y, 0, geometry.height - window_height);
+    *x = CLAMP (*x, monitor->x, monitor->x + monitor->width - width);
+    *y = CLAMP (*y, monitor->y, monitor->y + monitor->height - height);
+}
 
-    gtk_window_move (GTK_WINDOW (icon->search_window), x, y);
+static void
+_ensure_search_window (InvenioStatusIcon *icon)
+{
+    if (icon->search_window)
+        return;
+
+    icon->search_window = invenio_search_window_get_default ();
     gtk_window_set_keep_above (GTK_WINDOW (icon->search_window), TRUE);
-    gtk_window_present (GTK_WINDOW (icon->search_window));
+}
+
+static void
+_summon (InvenioStatusIcon  *icon,
+         const guint32       timestamp,
+         const gint64        activation_time)
+{
+    gint x, y;
 
-    g_object_ref_sink (menu);
+    /* only if summoned before the startup stage built it */
+    if (G_UNLIKELY (! icon->search_window))
+        _ensure_search_window (icon);
+
+    /*
+     * This is on the path between the hotkey and the window appearing, so it
+     * must not allocate or wait on the X server: the icon and monitor geometry
+     * are cached and only re-queried once the window is up.
+     */
+    if (G_UNLIKELY (! icon->geometry.valid))
+        _update_geometry (icon);
+
+    _position_search_window (icon, &x, &y);
+
+    gtk_window_move (GTK_WINDOW (icon->search_window), x, y);
+    invenio_search_window_present (timestamp, activation_time);
+
+    /* pick up panel moves which do not emit any signal for the next summon */
+    if (! icon->geometry.refresh_id)
+        icon->geometry.refresh_id = g_idle_add_full (G_PRIORITY_LOW, _refresh_geometry, icon, NULL);
+}
+
+static void
+_icon_activate (GtkStatusIcon   *status_icon,
+                gpointer         user_data)
+{
+    g_return_if_fail (status_icon);
+    g_return_if_fail (GTK_IS_STATUS_ICON (status_icon));
+    g_return_if_fail (user_data);
+
+    _summon ((InvenioStatusIcon *) user_data,
+             gtk_get_current_event_time (), g_get_monotonic_time ());
+}
+
+static gboolean
+_icon_size_changed (GtkStatusIcon   *status_icon,
+                    gint             size,
+                    gpointer         user_data)
+{
+    _invalidate_geometry ((InvenioStatusIcon *) user_data);
+    return FALSE;
+}
+
+static void
+_icon_notify (GObject       *object,
+              GParamSpec    *pspec,
+              gpointer       user_data)
+{
+    _invalidate_geometry ((InvenioStatusIcon *) user_data);
+}
+
+static void
+_screen_changed (GdkScreen  *screen,
+                 gpointer    user_data)
+{
+    _invalidate_geometry ((InvenioStatusIcon *) user_data);
 }
 
 static void
@@ -149,36 +293,155 @@ static void
 _icon_activate_wrapper (const gchar *string,
                         gpointer     user_data)
 {
-    _icon_activate (icon->status_icon, icon);
+    _summon (icon,
+             lash_get_current_event_time (),
+             lash_get_current_event_monotonic_time ());
+}
+
+static void
+_bind_menu_shortcut (InvenioStatusIcon *icon)
+{
+    const gchar *menu_shortcut;
+
+    if (icon->key_binding)
+    {
+        lash_unbind (icon->key_binding);
+        icon->key_binding = NULL;
+    }
+
+    menu_shortcut = invenio_configuration_get_snapshot ()->menu_shortcut;
+    if (menu_shortcut && g_strcmp0 (menu_shortcut, "") != 0)
+        icon->key_binding = lash_bind (menu_shortcut, _icon_activate_wrapper, icon);
+}
+
+static void
+_configuration_changed (const InvenioConfigurationChange    changes,
+                        gpointer                            user_data)
+{
+    InvenioStatusIcon *icon;
+    guint categories;
+
+    icon = (InvenioStatusIcon *) user_data;
+
+    if (changes & INVENIO_CONFIGURATION_CHANGE_MENU_SHORTCUT)
+        _bind_menu_shortcut (icon);
+
+    /* prime the index for categories which have just been enabled, only */
+    if (changes & INVENIO_CONFIGURATION_CHANGE_SEARCH_CATEGORIES)
+    {
+        categories = _enabled_categories ();
+
+        if (categories & ~icon->categories)
+            invenio_query_warm_up (categories & ~icon->categories, NULL, NULL);
+
+        icon->categories = categories;
+    }
+}
+
+static gboolean
+_startup_save_configuration (gpointer user_data)
+{
+    invenio_configuration_save ();
+
+    /* pick up external edits, and changes pushed by invenio-preferences */
+    invenio_configuration_monitor ();
+    invenio_remote_export ();
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_startup_tracker_warmed_up (const gint64    duration,
+                            gpointer        user_data)
+{
+    invenio_startup_stage_end (INVENIO_STARTUP_STAGE_TRACKER_WARM_UP);
+}
+
+static gboolean
+_startup_connect_tracker (gpointer user_data)
+{
+    InvenioStatusIcon *icon;
+
+    icon = (InvenioStatusIcon *) user_data;
+
+    invenio_startup_stage_begin (INVENIO_STARTUP_STAGE_TRACKER_CLIENT);
+    invenio_query_connect ();
+    invenio_startup_stage_end (INVENIO_STARTUP_STAGE_TRACKER_CLIENT);
+
+    invenio_startup_stage_begin (INVENIO_STARTUP_STAGE_TRACKER_WARM_UP);
+    icon->categories = _enabled_categories ();
+    invenio_query_warm_up (icon->categories, _startup_tracker_warmed_up, NULL);
+
+    g_idle_add_full (G_PRIORITY_LOW, _startup_save_configuration, NULL, NULL);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_startup_create_search_window (gpointer user_data)
+{
+    InvenioStatusIcon *icon;
+
+    icon = (InvenioStatusIcon *) user_data;
+
+    invenio_startup_stage_begin (INVENIO_STARTUP_STAGE_SEARCH_WINDOW);
+    _ensure_search_window (icon);
+    invenio_startup_stage_end (INVENIO_STARTUP_STAGE_SEARCH_WINDOW);
+
+    invenio_startup_stage_begin (INVENIO_STARTUP_STAGE_HISTORY);
+    invenio_history_load ();
+    invenio_startup_stage_end (INVENIO_STARTUP_STAGE_HISTORY);
+
+    g_idle_add_full (G_PRIORITY_LOW, _startup_connect_tracker, icon, NULL);
+
+    return G_SOURCE_REMOVE;
 }
 
 void
 invenio_status_icon_create (void)
 {
-    gchar *menu_shortcut;
-
     g_return_if_fail (! icon);
 
-    lash_init ();
+    /*
+     * Only what is needed to respond to the user (the status icon and the
+     * hotkey) is brought up before entering the main loop.  The search window
+     * and the tracker connection (and its warm-up queries) are set up in idle
+     * stages afterwards, so that they are ready before they are first used.
+     */
+    invenio_startup_stage_begin (INVENIO_STARTUP_STAGE_CONFIGURATION);
     invenio_configuration_load ();
+    invenio_startup_stage_end (INVENIO_STARTUP_STAGE_CONFIGURATION);
 
-    icon = g_new (InvenioStatusIcon, 1);
-    icon->status_icon = gtk_status_icon_new_from_stock (GTK_STOCK_FIND);
-    icon->context_menu = _context_menu_create_for_icon (icon);
-    icon->search_window = invenio_search_window_get_default ();
+    icon = g_new0 (InvenioStatusIcon, 1);
 
-    menu_shortcut = invenio_configuration_get_menu_shortcut ();
-    if (menu_shortcut && g_strcmp0 (menu_shortcut, "") != 0) {
-        icon->key_binding = lash_bind (menu_shortcut, _icon_activate_wrapper, icon);
-        g_free (menu_shortcut);
-    }
+    invenio_startup_stage_begin (INVENIO_STARTUP_STAGE_HOTKEY);
+    lash_init ();
+    _bind_menu_shortcut (icon);
+    invenio_configuration_add_notify (_configuration_changed, icon);
+    invenio_startup_stage_end (INVENIO_STARTUP_STAGE_HOTKEY);
 
-    /* TODO create a _destroy and call there */
-    invenio_configuration_save ();
+    invenio_startup_stage_begin (INVENIO_STARTUP_STAGE_STATUS_ICON);
+    icon->status_icon = gtk_status_icon_new_from_stock (GTK_STOCK_FIND);
+    icon->context_menu = _context_menu_create_for_icon (icon);
 
     g_signal_connect (G_OBJECT (icon->status_icon), "activate",
                       G_CALLBACK (_icon_activate), icon);
     g_signal_connect (G_OBJECT (icon->status_icon), "popup-menu",
                       G_CALLBACK (_icon_popup_menu), icon);
-}
 
+    g_signal_connect (G_OBJECT (icon->status_icon), "size-changed",
+                      G_CALLBACK (_icon_size_changed), icon);
+    g_signal_connect (G_OBJECT (icon->status_icon), "notify::embedded",
+                      G_CALLBACK (_icon_notify), icon);
+    g_signal_connect (G_OBJECT (icon->status_icon), "notify::orientation",
+                      G_CALLBACK (_icon_notify), icon);
+    g_signal_connect (G_OBJECT (icon->status_icon), "notify::screen",
+                      G_CALLBACK (_icon_notify), icon);
+    g_signal_connect (G_OBJECT (gtk_status_icon_get_screen (icon->status_icon)), "monitors-changed",
+                      G_CALLBACK (_screen_changed), icon);
+    g_signal_connect (G_OBJECT (gtk_status_icon_get_screen (icon->status_icon)), "size-changed",
+                      G_CALLBACK (_screen_changed), icon);
+    invenio_startup_stage_end (INVENIO_STARTUP_STAGE_STATUS_ICON);
+
+    g_idle_add (_startup_create_search_window, icon);
+}
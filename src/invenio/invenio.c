@@ -32,15 +32,45 @@
 
 #include <gtk/gtk.h>
 
+#include "invenio-history.h"
+#include "invenio-startup.h"
 #include "invenio-status-icon.h"
+#include "libinvenio/invenio-configuration.h"
+
+static gboolean startup_report;
+
+static GOptionEntry entries[] =
+{
+    { "startup-report", 0, 0, G_OPTION_ARG_NONE, &startup_report,
+      "Print a breakdown of the time spent in each startup stage", NULL },
+    { NULL },
+};
 
 int
 main (int argc, char **argv)
 {
-    gtk_init (&argc, &argv);
+    GError *error = NULL;
+
+    invenio_startup_init ();
+
+    invenio_startup_stage_begin (INVENIO_STARTUP_STAGE_TOOLKIT);
+    if (! gtk_init_with_args (&argc, &argv, NULL, entries, NULL, &error))
+    {
+        g_printerr ("%s\n", error ? error->message : "Unable to initialize GTK+");
+        if (error)
+            g_error_free (error);
+        return EXIT_FAILURE;
+    }
+    invenio_startup_stage_end (INVENIO_STARTUP_STAGE_TOOLKIT);
+
+    invenio_startup_set_report (startup_report);
+
     invenio_status_icon_create ();
     gtk_main ();
 
+    invenio_configuration_flush ();
+    invenio_history_flush ();
+
     return EXIT_SUCCESS;
 }
 
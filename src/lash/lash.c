@@ -30,11 +30,24 @@
 
 #include "lash/lash.h"
 
+#include <string.h>
+
 #include <gtk/gtk.h>
 #include <gdk/gdk.h>
 #include <gdk/gdkx.h>
 
 #include <X11/Xlib.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+
+#define LASH_MAX_KEYCODES       (8)
+
+typedef struct _LashKeyMapping
+{
+    GdkModifierType  modifiers;
+    guint            n_keycodes;
+    guint            keycodes[LASH_MAX_KEYCODES];
+} LashKeyMapping;
 
 struct _LashKeyBinding
 {
@@ -42,23 +55,63 @@ struct _LashKeyBinding
     LashCallback     callback;
     gpointer         user_data;
 
-    guint            keycode;
-    GdkModifierType  modifiers;
+    guint            keyval;
+    GdkModifierType  accelerator_modifiers;
+
+    LashKeyMapping   mapping;
+    gboolean         grabbed;
 };
 
+typedef struct _LashGrabRequest
+{
+    LashKeyBinding  *binding;
+    gulong           first;
+    gulong           last;
+    guchar           error_code;
+} LashGrabRequest;
+
+
+#define LASH_KEYBOARD_MODIFIERS (ShiftMask | LockMask | ControlMask |                  \
+                                 Mod1Mask | Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask)
+
+#define LASH_DISPATCH_KEY(keycode, state)                                               \
+    GUINT_TO_POINTER (((keycode) << 8) | ((state) & LASH_KEYBOARD_MODIFIERS & ~lock_modifiers))
+
 
 static GSList *bindings;
 
-static guint ignored_modifiers[] =
+/* (keycode, modifiers) -> GSList of bindings, for dispatching KeyPress events */
+static GHashTable *dispatch;
+
+/* bindings waiting for lash_thaw_grabs */
+static guint frozen;
+static GSList *queued;
+
+/* the grab batch currently being synchronised */
+static GArray *grab_requests;
+static XErrorHandler grab_previous_handler;
+
+/* the KeyPress currently being dispatched to the binding callbacks */
+static struct
 {
-    GDK_LOCK_MASK,
-    GDK_MOD2_MASK,
-    GDK_MOD3_MASK,
-    GDK_LOCK_MASK | GDK_MOD2_MASK,
-    GDK_LOCK_MASK | GDK_MOD3_MASK,
-    GDK_MOD2_MASK | GDK_MOD3_MASK,
-    GDK_LOCK_MASK | GDK_MOD2_MASK | GDK_MOD3_MASK,
-};
+    guint32          time;
+    gint64           monotonic_time;
+} current_event;
+
+/* keymap change bookkeeping */
+static struct
+{
+    guint            keymap_changes;
+    guint            regrabs;
+    gint64           elapsed;
+} statistics;
+
+/*
+ * The modifiers which are bound to lock keys (Caps Lock, Num Lock, Scroll
+ * Lock) in the current keymap.  Their state is ignored for bindings, so each
+ * binding is grabbed once for every combination of them.
+ */
+static guint lock_modifiers = LockMask;
 
 
 static LashKeyBinding *
@@ -84,6 +137,42 @@ lash_key_binding_free (LashKeyBinding *binding)
 }
 
 
+static void
+_register_binding (LashKeyBinding *binding)
+{
+    gpointer key;
+    GSList *list;
+    guint i;
+
+    for (i = 0; i < binding->mapping.n_keycodes; i++)
+    {
+        key = LASH_DISPATCH_KEY (binding->mapping.keycodes[i], binding->mapping.modifiers);
+
+        list = g_hash_table_lookup (dispatch, key);
+        g_hash_table_insert (dispatch, key, g_slist_prepend (list, binding));
+    }
+}
+
+static void
+_unregister_binding (LashKeyBinding *binding)
+{
+    gpointer key;
+    GSList *list;
+    guint i;
+
+    for (i = 0; i < binding->mapping.n_keycodes; i++)
+    {
+        key = LASH_DISPATCH_KEY (binding->mapping.keycodes[i], binding->mapping.modifiers);
+
+        list = g_slist_remove (g_hash_table_lookup (dispatch, key), binding);
+
+        if (list)
+            g_hash_table_insert (dispatch, key, list);
+        else
+            g_hash_table_remove (dispatch, key);
+    }
+}
+
 static GdkFilterReturn
 _handle_bindings (GdkXEvent *xevent,
                   GdkEvent  *event,
@@ -91,48 +180,104 @@ _handle_bindings (GdkXEvent *xevent,
 {
     XEvent *xev;
     GSList *iter;
-    guint state;
 
     xev = (XEvent *) xevent;
-    state = xev->xkey.state & ~(GDK_LOCK_MASK | GDK_MOD2_MASK | GDK_MOD3_MASK);
 
-    if (xev->type == KeyPress)
+    /* this sees every event delivered to the root window */
+    if (xev->type != KeyPress)
+        return GDK_FILTER_CONTINUE;
+
+    current_event.time = xev->xkey.time;
+    current_event.monotonic_time = g_get_monotonic_time ();
+
+    iter = g_hash_table_lookup (dispatch, LASH_DISPATCH_KEY (xev->xkey.keycode, xev->xkey.state));
+
+    for (; iter; iter = iter->next)
     {
-        for (iter = bindings; iter; iter = iter->next)
-        {
-            LashKeyBinding *binding = (LashKeyBinding *) iter->data;
+        LashKeyBinding *binding = (LashKeyBinding *) iter->data;
 
-            if (xev->xkey.keycode == binding->keycode && state == binding->modifiers)
-            {
-                (binding->callback)(binding->string, binding->user_data);
-            }
-        }
+        (binding->callback)(binding->string, binding->user_data);
     }
 
+    current_event.time = GDK_CURRENT_TIME;
+    current_event.monotonic_time = 0;
+
     return GDK_FILTER_CONTINUE;
 }
 
+static guint
+_modifier_for_keysym (Display       *display,
+                      const KeySym   keysym)
+{
+    XModifierKeymap *modmap;
+    KeyCode keycode;
+    guint mask = 0;
+    gint i;
+
+    if (! (keycode = XKeysymToKeycode (display, keysym)))
+        return 0;
+
+    modmap = XGetModifierMapping (display);
+
+    for (i = 0; i < 8 * modmap->max_keypermod; i++)
+        if (modmap->modifiermap[i] == keycode)
+            mask |= 1 << (i / modmap->max_keypermod);
+
+    XFreeModifiermap (modmap);
+
+    return mask;
+}
+
+static guint
+_query_lock_modifiers (void)
+{
+    gint opcode, event, error, major, minor;
+    Display *display;
+    guint locks;
+
+    display = gdk_x11_display_get_xdisplay (gdk_display_get_default ());
+
+    major = XkbMajorVersion;
+    minor = XkbMinorVersion;
+
+    locks = LockMask;
+
+    if (XkbQueryExtension (display, &opcode, &event, &error, &major, &minor))
+    {
+        locks |= XkbKeysymToModifiers (display, XK_Num_Lock);
+        locks |= XkbKeysymToModifiers (display, XK_Scroll_Lock);
+    }
+    else
+    {
+        locks |= _modifier_for_keysym (display, XK_Num_Lock);
+        locks |= _modifier_for_keysym (display, XK_Scroll_Lock);
+    }
+
+    return locks & LASH_KEYBOARD_MODIFIERS;
+}
+
 static void
 _GrabKey(const guint            keycode,
          const GdkModifierType  modifiers)
 {
     GdkDisplay *display;
     GdkWindow  *window;
-    guint       i;
+    guint       locks;
 
     window = gdk_get_default_root_window ();
     display = gdk_window_get_display (window);
 
-    XGrabKey (gdk_x11_display_get_xdisplay (display),
-              keycode, modifiers,
-              gdk_x11_window_get_xid (window),
-              True, GrabModeAsync, GrabModeAsync);
-
-    for (i = 0; i < G_N_ELEMENTS (ignored_modifiers); i++)
+    /* enumerate every subset of the lock modifiers, starting with none */
+    locks = 0;
+    do
+    {
         XGrabKey (gdk_x11_display_get_xdisplay (display),
-                  keycode, modifiers | ignored_modifiers[i],
+                  keycode, modifiers | locks,
                   gdk_x11_window_get_xid (window),
                   True, GrabModeAsync, GrabModeAsync);
+        locks = (locks - lock_modifiers) & lock_modifiers;
+    }
+    while (locks);
 }
 
 static void
@@ -141,55 +286,210 @@ _UngrabKey(const guint              keycode,
 {
     GdkDisplay *display;
     GdkWindow  *window;
-    guint       i;
+    guint       locks;
 
     window = gdk_get_default_root_window ();
     display = gdk_window_get_display (window);
 
-    XUngrabKey (gdk_x11_display_get_xdisplay (display),
-                keycode, modifiers,
-                gdk_x11_window_get_xid (window));
-
-    for (i = 0; i < G_N_ELEMENTS (ignored_modifiers); i++)
+    locks = 0;
+    do
+    {
         XUngrabKey (gdk_x11_display_get_xdisplay (display),
-                    keycode, modifiers | ignored_modifiers[i],
+                    keycode, modifiers | locks,
                     gdk_x11_window_get_xid (window));
+        locks = (locks - lock_modifiers) & lock_modifiers;
+    }
+    while (locks);
 }
 
-static gboolean
-_map_binding (LashKeyBinding *binding,
-              GdkKeymap      *keymap)
+static void
+_grab_binding (const LashKeyBinding * const binding)
+{
+    guint i;
+
+    for (i = 0; i < binding->mapping.n_keycodes; i++)
+        _GrabKey (binding->mapping.keycodes[i], binding->mapping.modifiers);
+}
+
+static void
+_ungrab_binding (const LashKeyBinding * const binding)
 {
-    GdkKeymapKey *key = NULL;
-    GdkModifierType modifiers;
-    guint keyval, keycode;
-    gint n_keys;
+    guint i;
+
+    for (i = 0; i < binding->mapping.n_keycodes; i++)
+        _UngrabKey (binding->mapping.keycodes[i], binding->mapping.modifiers);
+}
+
+static int
+_grab_error_handler (Display     *display,
+                     XErrorEvent *error)
+{
+    guint i;
+
+    for (i = 0; i < grab_requests->len; i++)
+    {
+        LashGrabRequest *request = &g_array_index (grab_requests, LashGrabRequest, i);
+
+        if (error->serial >= request->first && error->serial <= request->last)
+        {
+            request->error_code = error->error_code;
+            return 0;
+        }
+    }
+
+    /* not one of ours, leave it to GDK */
+    return grab_previous_handler (display, error);
+}
+
+static GSList *
+_grab_bindings (GSList *list)
+{
+    Display *display;
+    GSList *failed = NULL;
+    guint i;
+
+    if (! list)
+        return NULL;
+
+    display = gdk_x11_display_get_xdisplay (gdk_display_get_default ());
 
-    gtk_accelerator_parse (binding->string, &keyval, &modifiers);
-    if (! keyval && ! modifiers)
+    /*
+     * Issue the grabs for every binding, remembering the request serials that
+     * belong to each one, and then wait for all of them with a single round
+     * trip.  A scoped error handler attributes BadAccess (the key combination
+     * is grabbed by another client) to the binding which caused it.  It is in
+     * place before the first grab, as Xlib may flush its buffer (and so report
+     * errors) at any point while they are issued, and a request is recorded
+     * before it is issued, open ended until its last serial is known.
+     */
+    grab_requests = g_array_sized_new (FALSE, TRUE, sizeof (LashGrabRequest),
+                                       g_slist_length (list));
+
+    grab_previous_handler = XSetErrorHandler (_grab_error_handler);
+
+    for (; list; list = list->next)
+    {
+        LashGrabRequest request = { (LashKeyBinding *) list->data, 0, G_MAXULONG, Success };
+
+        request.first = NextRequest (display);
+        g_array_append_val (grab_requests, request);
+
+        _grab_binding (request.binding);
+
+        g_array_index (grab_requests, LashGrabRequest, grab_requests->len - 1).last =
+            NextRequest (display) - 1;
+    }
+
+    XSync (display, False);
+    XSetErrorHandler (grab_previous_handler);
+
+    for (i = 0; i < grab_requests->len; i++)
+    {
+        LashGrabRequest *request = &g_array_index (grab_requests, LashGrabRequest, i);
+
+        request->binding->grabbed = (request->error_code == Success);
+
+        if (! request->binding->grabbed)
+        {
+            g_warning ("Unable to grab key binding '%s'%s",
+                       request->binding->string,
+                       request->error_code == BadAccess ? ": already grabbed by another client" : "");
+
+            /* release the combinations which did succeed */
+            _ungrab_binding (request->binding);
+
+            failed = g_slist_prepend (failed, request->binding);
+        }
+    }
+
+    g_array_free (grab_requests, TRUE);
+    grab_requests = NULL;
+
+    return failed;
+}
+
+static gboolean
+_parse_binding (LashKeyBinding *binding)
+{
+    gtk_accelerator_parse (binding->string, &binding->keyval, &binding->accelerator_modifiers);
+    if (! binding->keyval && ! binding->accelerator_modifiers)
     {
         g_printerr ("Unable to parse accelerator '%s'", binding->string);
         return FALSE;
     }
 
-    if (! gtk_accelerator_valid (keyval, modifiers))
+    if (! gtk_accelerator_valid (binding->keyval, binding->accelerator_modifiers))
     {
         g_printerr ("Accelerator '%s' is invalid with current keymap", binding->string);
         return FALSE;
     }
 
-    if (! gdk_keymap_get_entries_for_keyval (keymap, keyval, &key, &n_keys))
+    return TRUE;
+}
+
+static gboolean
+_map_binding (const LashKeyBinding * const  binding,
+              GdkKeymap                    *keymap,
+              LashKeyMapping               *mapping)
+{
+    GdkModifierType modifiers, virtual_modifiers;
+    GdkKeymapKey *keys = NULL;
+    guint keycode, i, j;
+    gint n_keys, k;
+
+    memset (mapping, 0, sizeof (*mapping));
+
+    /*
+     * Only real modifiers are reported in the key event state, so resolve any
+     * virtual modifiers (e.g. <super>) against the current keymap.
+     */
+    modifiers = binding->accelerator_modifiers;
+    virtual_modifiers = modifiers & ~LASH_KEYBOARD_MODIFIERS;
+    if (virtual_modifiers)
+    {
+        gdk_keymap_map_virtual_modifiers (keymap, &virtual_modifiers);
+        virtual_modifiers &= LASH_KEYBOARD_MODIFIERS;
+
+        if (! virtual_modifiers)
+        {
+            g_printerr ("Unable to map modifiers of accelerator '%s'", binding->string);
+            return FALSE;
+        }
+
+        modifiers = (modifiers & LASH_KEYBOARD_MODIFIERS) | virtual_modifiers;
+    }
+
+    if (! gdk_keymap_get_entries_for_keyval (keymap, binding->keyval, &keys, &n_keys))
     {
-        g_printerr ("Unable to get keycode for keyval %#x", keyval);
+        g_printerr ("Unable to get keycode for keyval %#x", binding->keyval);
         return FALSE;
     }
 
-    keycode = key->keycode;
+    /*
+     * The keyval may be produced by several keys (e.g. in different groups);
+     * grab all of them.  The keycodes are kept sorted so that mappings can be
+     * compared directly.
+     */
+    for (k = 0; k < n_keys && mapping->n_keycodes < LASH_MAX_KEYCODES; k++)
+    {
+        keycode = keys[k].keycode;
+
+        for (i = 0; i < mapping->n_keycodes && mapping->keycodes[i] < keycode; i++)
+            ;
+
+        if (i < mapping->n_keycodes && mapping->keycodes[i] == keycode)
+            continue;
+
+        for (j = mapping->n_keycodes; j > i; j--)
+            mapping->keycodes[j] = mapping->keycodes[j - 1];
+
+        mapping->keycodes[i] = keycode;
+        mapping->n_keycodes++;
+    }
 
-    g_free (key);
+    g_free (keys);
 
-    binding->keycode = keycode;
-    binding->modifiers = modifiers;
+    mapping->modifiers = modifiers;
 
     return TRUE;
 }
@@ -198,22 +498,96 @@ static void
 keymap_changed (GdkKeymap   *keymap,
                 gpointer     user_data)
 {
-    GSList *binding;
+    GSList *binding, *regrab = NULL;
+    LashKeyMapping mapping;
+    guint remapped = 0;
+    gint64 start;
+    guint locks;
+
+    start = g_get_monotonic_time ();
+
+    /*
+     * When the lock modifiers move, every binding needs to be grabbed with a
+     * different set of combinations.  Release them all with the old set and
+     * clear their mappings so that they are all regrabbed below.
+     */
+    locks = _query_lock_modifiers ();
+    if (locks != lock_modifiers)
+    {
+        for (binding = bindings; binding; binding = binding->next)
+        {
+            LashKeyBinding *keybinding = (LashKeyBinding *) binding->data;
+
+            if (keybinding->grabbed)
+                _ungrab_binding (keybinding);
+            keybinding->grabbed = FALSE;
+
+            _unregister_binding (keybinding);
+            memset (&keybinding->mapping, 0, sizeof (keybinding->mapping));
+        }
 
+        g_debug ("lock modifiers changed from %#x to %#x", lock_modifiers, locks);
+        lock_modifiers = locks;
+    }
+
+    /*
+     * Layout switchers and input methods emit keys-changed frequently, usually
+     * without affecting the bindings.  Only go to the X server for the
+     * bindings whose keycodes or modifiers actually changed.
+     */
     for (binding = bindings; binding; binding = binding->next)
     {
         LashKeyBinding *keybinding = (LashKeyBinding *) binding->data;
 
-        _UngrabKey (keybinding->keycode, keybinding->modifiers);
+        if (! _map_binding (keybinding, keymap, &mapping))
+            memset (&mapping, 0, sizeof (mapping));
+
+        if (memcmp (&mapping, &keybinding->mapping, sizeof (mapping)) == 0)
+            continue;
+
+        if (keybinding->grabbed)
+            _ungrab_binding (keybinding);
+        keybinding->grabbed = FALSE;
+
+        _unregister_binding (keybinding);
+        keybinding->mapping = mapping;
+        _register_binding (keybinding);
+
+        if (mapping.n_keycodes)
+            regrab = g_slist_prepend (regrab, keybinding);
 
-        if (_map_binding (keybinding, keymap))
-            _GrabKey(keybinding->keycode, keybinding->modifiers);
+        remapped++;
+    }
+
+    statistics.keymap_changes++;
+    statistics.regrabs += remapped;
+
+    if (frozen)
+    {
+        queued = g_slist_concat (regrab, queued);
+    }
+    else
+    {
+        g_slist_free (_grab_bindings (regrab));
+        g_slist_free (regrab);
     }
+
+    statistics.elapsed += g_get_monotonic_time () - start;
+
+    g_debug ("keymap changed: %u of %u bindings regrabbed in %.3f ms "
+             "(%u regrabs over %u keymap changes, %.3f ms in total)",
+             remapped, g_slist_length (bindings),
+             (g_get_monotonic_time () - start) / 1000.0,
+             statistics.regrabs, statistics.keymap_changes,
+             statistics.elapsed / 1000.0);
 }
 
 void
 lash_init (void)
 {
+    dispatch = g_hash_table_new (g_direct_hash, g_direct_equal);
+    lock_modifiers = _query_lock_modifiers ();
+
     gdk_window_add_filter (gdk_get_default_root_window (), _handle_bindings, NULL);
     g_signal_connect (gdk_keymap_get_default (), "keys-changed", G_CALLBACK (keymap_changed), NULL);
 }
@@ -221,12 +595,13 @@ lash_init (void)
 void
 lash_fini (void)
 {
-    GSList *binding;
-
     gdk_window_remove_filter (gdk_get_default_root_window (), _handle_bindings, NULL);
 
-    for (binding = bindings; binding; binding = binding->next)
-        lash_unbind ((LashKeyBinding *) binding->data);
+    while (bindings)
+        lash_unbind ((LashKeyBinding *) bindings->data);
+
+    g_hash_table_destroy (dispatch);
+    dispatch = NULL;
 }
 
 LashKeyBinding *
@@ -235,18 +610,35 @@ lash_bind (const gchar  *string,
            gpointer      user_data)
 {
     LashKeyBinding *binding;
+    GSList list, *failed;
 
     binding = lash_key_binding_new (string, callback, user_data);
 
-    if (! _map_binding (binding, gdk_keymap_get_default ()))
+    if (! _parse_binding (binding)
+        || ! _map_binding (binding, gdk_keymap_get_default (), &binding->mapping))
     {
         lash_key_binding_free (binding);
         return NULL;
     }
 
-    _GrabKey (binding->keycode, binding->modifiers);
-
     bindings = g_slist_prepend (bindings, binding);
+    _register_binding (binding);
+
+    if (frozen)
+    {
+        queued = g_slist_prepend (queued, binding);
+        return binding;
+    }
+
+    list.data = binding;
+    list.next = NULL;
+
+    if ((failed = _grab_bindings (&list)))
+    {
+        g_slist_free (failed);
+        lash_unbind (binding);
+        return NULL;
+    }
 
     return binding;
 }
@@ -254,10 +646,55 @@ lash_bind (const gchar  *string,
 void
 lash_unbind (LashKeyBinding *binding)
 {
-    _UngrabKey(binding->keycode, binding->modifiers);
+    if (binding->grabbed)
+        _ungrab_binding (binding);
 
     bindings = g_slist_remove_all (bindings, binding);
+    queued = g_slist_remove_all (queued, binding);
+    _unregister_binding (binding);
 
     lash_key_binding_free (binding);
 }
 
+void
+lash_freeze_grabs (void)
+{
+    frozen++;
+}
+
+/*
+ * Grabs the keys of every binding made (or remapped) since lash_freeze_grabs
+ * with a single round trip to the X server.  Returns the bindings which could
+ * not be grabbed; they stay bound (but inactive) until lash_unbind.  The list
+ * must be freed with g_slist_free.
+ */
+GSList *
+lash_thaw_grabs (void)
+{
+    GSList *failed;
+
+    g_return_val_if_fail (frozen, NULL);
+
+    if (--frozen)
+        return NULL;
+
+    failed = _grab_bindings (queued);
+
+    g_slist_free (queued);
+    queued = NULL;
+
+    return failed;
+}
+
+
+guint32
+lash_get_current_event_time (void)
+{
+    return current_event.time;
+}
+
+gint64
+lash_get_current_event_monotonic_time (void)
+{
+    return current_event.monotonic_time;
+}
@@ -50,5 +50,17 @@ lash_bind (const gchar  *string,
 void
 lash_unbind (LashKeyBinding *binding);
 
+void
+lash_freeze_grabs (void);
+
+GSList *
+lash_thaw_grabs (void);
+
+guint32
+lash_get_current_event_time (void);
+
+gint64
+lash_get_current_event_monotonic_time (void);
+
 #endif
 
@@ -62,6 +62,14 @@ static const gchar * const InvenioCategoryString[INVENIO_CATEGORIES] =
     [INVENIO_CATEGORY_VIDEO]        = "Videos",
 };
 
+/* category icons, loaded on first use */
+static struct
+{
+    gboolean     connected;
+    gboolean     loaded[INVENIO_CATEGORIES];
+    GdkPixbuf   *pixbuf[INVENIO_CATEGORIES];
+} pixbuf_cache;
+
 const gchar *
 invenio_category_to_string (const InvenioCategory category)
 {
@@ -80,8 +88,24 @@ invenio_category_from_string (const gchar * const category)
     return INVENIO_CATEGORIES;
 }
 
-GdkPixbuf *
-invenio_category_to_pixbuf (const InvenioCategory category)
+static void
+_icon_theme_changed (GtkIconTheme   *icon_theme,
+                     gpointer        user_data)
+{
+    InvenioCategory category;
+
+    for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+    {
+        if (pixbuf_cache.pixbuf[category])
+            g_object_unref (pixbuf_cache.pixbuf[category]);
+
+        pixbuf_cache.pixbuf[category] = NULL;
+        pixbuf_cache.loaded[category] = FALSE;
+    }
+}
+
+static GdkPixbuf *
+_load_pixbuf (const InvenioCategory category)
 {
     GdkPixbuf *pixbuf = NULL;
     GtkIconInfo *icon_info;
@@ -105,3 +129,23 @@ invenio_category_to_pixbuf (const InvenioCategory category)
     return pixbuf;
 }
 
+/* returns a borrowed reference, valid until the icon theme changes */
+GdkPixbuf *
+invenio_category_to_pixbuf (const InvenioCategory category)
+{
+    if (G_UNLIKELY (! pixbuf_cache.connected))
+    {
+        g_signal_connect (G_OBJECT (gtk_icon_theme_get_default ()), "changed",
+                          G_CALLBACK (_icon_theme_changed), NULL);
+        pixbuf_cache.connected = TRUE;
+    }
+
+    /* a failed lookup is remembered as well, until the theme changes */
+    if (! pixbuf_cache.loaded[category])
+    {
+        pixbuf_cache.pixbuf[category] = _load_pixbuf (category);
+        pixbuf_cache.loaded[category] = TRUE;
+    }
+
+    return pixbuf_cache.pixbuf[category];
+}
@@ -30,11 +30,15 @@
 
 #include "invenio-configuration.h"
 
+#include <string.h>
+
 #include <gio/gio.h>
 
 #define INVENIO_CONFIGURATION_KEYFILE                   "invenio.cfg"
+#define INVENIO_CONFIGURATION_SAVE_DELAY                (500)
 #define INVENIO_CONFIGURATION_GENERAL                   "general"
 #define INVENIO_CONFIGURATION_SEARCH                    "search"
+#define INVENIO_CONFIGURATION_HISTORY                   "history"
 
 #define INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY         "menu-shortcut"
 #define INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY_VALUE   "<ctrl>space"
@@ -43,46 +47,161 @@
 #define INVENIO_CONFIGURATION_SEARCH_CATEGORIES         "search-categories"
 #define INVENIO_CONFIGURATION_SEARCH_CATEGORIES_COMMENT "Categories to get results from"
 
+#define INVENIO_CONFIGURATION_CATEGORY_ORDER            "category-order"
+#define INVENIO_CONFIGURATION_CATEGORY_ORDER_COMMENT    "Order in which categories are displayed"
+
+#define INVENIO_CONFIGURATION_CATEGORY_PRECEDENCE           "category-precedence"
+#define INVENIO_CONFIGURATION_CATEGORY_PRECEDENCE_COMMENT   "Categories in the order in which they keep a result returned by several of them"
+
+#define INVENIO_CONFIGURATION_WARM_HIDE                 "warm-hide"
+#define INVENIO_CONFIGURATION_WARM_HIDE_VALUE           TRUE
+#define INVENIO_CONFIGURATION_WARM_HIDE_COMMENT         "Keep the last search when the search window is hidden (default: true)"
+
+#define INVENIO_CONFIGURATION_STALENESS_THRESHOLD           "staleness-threshold"
+#define INVENIO_CONFIGURATION_STALENESS_THRESHOLD_VALUE     30
+#define INVENIO_CONFIGURATION_STALENESS_THRESHOLD_COMMENT   "Seconds after which kept results are refreshed on reopen (default: " G_STRINGIFY (INVENIO_CONFIGURATION_STALENESS_THRESHOLD_VALUE) ")"
+
+#define INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY          "results-per-category"
+#define INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY_VALUE    4
+#define INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY_MAX      50
+#define INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY_COMMENT  "Results displayed per category, may be overridden by a \"limit\" key in a group named after the category (default: " G_STRINGIFY (INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY_VALUE) ")"
+
+#define INVENIO_CONFIGURATION_QUERY_TIMEOUT                 "query-timeout"
+#define INVENIO_CONFIGURATION_QUERY_TIMEOUT_VALUE           0
+#define INVENIO_CONFIGURATION_QUERY_TIMEOUT_COMMENT         "Milliseconds to wait for the results of a category, 0 to wait indefinitely, may be overridden by a \"timeout\" key in a group named after the category (default: " G_STRINGIFY (INVENIO_CONFIGURATION_QUERY_TIMEOUT_VALUE) ")"
+
+#define INVENIO_CONFIGURATION_BEST_MATCHES                  "best-matches"
+#define INVENIO_CONFIGURATION_BEST_MATCHES_VALUE            0
+#define INVENIO_CONFIGURATION_BEST_MATCHES_MAX              50
+#define INVENIO_CONFIGURATION_BEST_MATCHES_COMMENT          "Results displayed in a single list ranked across categories, 0 to group results by category (default: " G_STRINGIFY (INVENIO_CONFIGURATION_BEST_MATCHES_VALUE) ")"
+
+#define INVENIO_CONFIGURATION_HISTORY_SIZE                  "size"
+#define INVENIO_CONFIGURATION_HISTORY_SIZE_VALUE            500
+#define INVENIO_CONFIGURATION_HISTORY_SIZE_MAX              100000
+#define INVENIO_CONFIGURATION_HISTORY_SIZE_COMMENT          "Number of launched results remembered for ranking (default: " G_STRINGIFY (INVENIO_CONFIGURATION_HISTORY_SIZE_VALUE) ")"
+
+#define INVENIO_CONFIGURATION_HISTORY_HALF_LIFE             "half-life"
+#define INVENIO_CONFIGURATION_HISTORY_HALF_LIFE_VALUE       14
+#define INVENIO_CONFIGURATION_HISTORY_HALF_LIFE_COMMENT     "Days after which a launch counts half as much for ranking (default: " G_STRINGIFY (INVENIO_CONFIGURATION_HISTORY_HALF_LIFE_VALUE) ")"
+
+#define INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS           "suggestions"
+#define INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS_VALUE     5
+#define INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS_MAX       50
+#define INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS_COMMENT   "Launched results suggested before anything is typed, 0 to disable (default: " G_STRINGIFY (INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS_VALUE) ")"
+
+#define INVENIO_CONFIGURATION_CATEGORY_LIMIT                "limit"
+#define INVENIO_CONFIGURATION_CATEGORY_TIMEOUT              "timeout"
+
+
+typedef struct InvenioConfigurationReload
+{
+    GKeyFile                        *keyfile;
+    InvenioConfigurationSnapshot    *snapshot;
+} InvenioConfigurationReload;
+
+typedef struct InvenioConfigurationWrite
+{
+    gchar                           *filename;
+    gchar                           *data;
+    gsize                            size;
+    guint                            generation;
+} InvenioConfigurationWrite;
+
+/* the key written by each of the setters */
+typedef struct InvenioConfigurationSetting
+{
+    InvenioConfigurationChange       change;
+    const gchar                     *group;
+    const gchar                     *key;
+} InvenioConfigurationSetting;
+
+typedef struct InvenioConfigurationWatch
+{
+    InvenioConfigurationNotify       callback;
+    gpointer                         user_data;
+} InvenioConfigurationWatch;
 
 typedef struct InvenioConfiguration
 {
-    gboolean         loaded;
+    gboolean                         loaded;
 
-    GFile           *file;
-    GKeyFile        *keyfile;
-    gboolean         dirty;
+    GFile                           *file;
+    GKeyFile                        *keyfile;
+    gboolean                         dirty;
 
-    struct
-    {
-        gboolean     category_enabled[INVENIO_CATEGORIES];
-    } cache;
+    /* settings changed here which are not known to be on disk yet */
+    InvenioConfigurationChange       unsaved;
+
+    InvenioConfigurationSnapshot    *snapshot;
+
+    /* deferred saving */
+    guint                            save_id;
+    guint                            generation;
+    guint                            writes;
+
+    /* file monitoring */
+    GFileMonitor                    *monitor;
+    gboolean                         reloading;
+    gboolean                         reload_pending;
+    GSList                          *watches;
 } InvenioConfiguration;
 
 
 static InvenioConfiguration configuration;
 
+static const InvenioConfigurationSetting InvenioConfigurationSettings[] =
+{
+    { INVENIO_CONFIGURATION_CHANGE_MENU_SHORTCUT,
+      INVENIO_CONFIGURATION_GENERAL, INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY },
+    { INVENIO_CONFIGURATION_CHANGE_SEARCH_CATEGORIES,
+      INVENIO_CONFIGURATION_SEARCH, INVENIO_CONFIGURATION_SEARCH_CATEGORIES },
+    { INVENIO_CONFIGURATION_CHANGE_CATEGORY_ORDER,
+      INVENIO_CONFIGURATION_SEARCH, INVENIO_CONFIGURATION_CATEGORY_ORDER },
+};
 
-static void
-_load_defaults (void)
+/* the more specific categories keep a result which several categories return */
+static const InvenioCategory InvenioConfigurationCategoryPrecedence[INVENIO_CATEGORIES] =
 {
-    if (! g_key_file_has_key (configuration.keyfile,
+    INVENIO_CATEGORY_APPLICATION,
+    INVENIO_CATEGORY_CONTACT,
+    INVENIO_CATEGORY_MESSAGE,
+    INVENIO_CATEGORY_IMAGE,
+    INVENIO_CATEGORY_MUSIC,
+    INVENIO_CATEGORY_VIDEO,
+    INVENIO_CATEGORY_FONT,
+    INVENIO_CATEGORY_FOLDER,
+    INVENIO_CATEGORY_DOCUMENT,
+    INVENIO_CATEGORY_BOOKMARK,
+};
+
+/* serializes writers; written is the generation of the last write to disk */
+static GMutex writer_lock;
+static guint written;
+
+
+static gboolean
+_load_defaults (GKeyFile *keyfile)
+{
+    gboolean dirty = FALSE;
+
+    if (! g_key_file_has_key (keyfile,
                               INVENIO_CONFIGURATION_GENERAL,
                               INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY,
                               NULL))
     {
-        g_key_file_set_comment (configuration.keyfile,
+        g_key_file_set_comment (keyfile,
                                 INVENIO_CONFIGURATION_GENERAL,
                                 INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY,
                                 INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY_COMMENT,
                                 NULL);
-        g_key_file_set_string (configuration.keyfile,
+        g_key_file_set_string (keyfile,
                                INVENIO_CONFIGURATION_GENERAL,
                                INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY,
                                INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY_VALUE);
-        configuration.dirty = TRUE;
+        dirty = TRUE;
     }
 
-    if (! g_key_file_has_key (configuration.keyfile,
+    if (! g_key_file_has_key (keyfile,
                               INVENIO_CONFIGURATION_SEARCH,
                               INVENIO_CONFIGURATION_SEARCH_CATEGORIES,
                               NULL))
@@ -93,47 +212,513 @@ _load_defaults (void)
         search_categories = g_malloc0 (sizeof (gchar *) * INVENIO_CATEGORIES);
 
         for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
-        {
             search_categories[category] = invenio_category_to_string (category);
-            configuration.cache.category_enabled[category] = TRUE;
-        }
 
-        g_key_file_set_comment (configuration.keyfile,
+        g_key_file_set_comment (keyfile,
                                 INVENIO_CONFIGURATION_SEARCH,
                                 INVENIO_CONFIGURATION_SEARCH_CATEGORIES,
                                 INVENIO_CONFIGURATION_SEARCH_CATEGORIES_COMMENT,
                                 NULL);
-        g_key_file_set_string_list (configuration.keyfile,
+        g_key_file_set_string_list (keyfile,
                                     INVENIO_CONFIGURATION_SEARCH,
                                     INVENIO_CONFIGURATION_SEARCH_CATEGORIES,
                                     search_categories,
                                     INVENIO_CATEGORIES);
-        configuration.dirty = TRUE;
+        dirty = TRUE;
 
         g_free (search_categories);
     }
+
+    if (! g_key_file_has_key (keyfile,
+                              INVENIO_CONFIGURATION_SEARCH,
+                              INVENIO_CONFIGURATION_CATEGORY_ORDER,
+                              NULL))
+    {
+        const gchar **category_order;
+        InvenioCategory category;
+
+        category_order = g_malloc0 (sizeof (gchar *) * INVENIO_CATEGORIES);
+
+        for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+            category_order[category] = invenio_category_to_string (category);
+
+        g_key_file_set_comment (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_CATEGORY_ORDER,
+                                INVENIO_CONFIGURATION_CATEGORY_ORDER_COMMENT,
+                                NULL);
+        g_key_file_set_string_list (keyfile,
+                                    INVENIO_CONFIGURATION_SEARCH,
+                                    INVENIO_CONFIGURATION_CATEGORY_ORDER,
+                                    category_order,
+                                    INVENIO_CATEGORIES);
+        dirty = TRUE;
+
+        g_free (category_order);
+    }
+
+    if (! g_key_file_has_key (keyfile,
+                              INVENIO_CONFIGURATION_SEARCH,
+                              INVENIO_CONFIGURATION_CATEGORY_PRECEDENCE,
+                              NULL))
+    {
+        const gchar **category_precedence;
+        guint i;
+
+        category_precedence = g_malloc0 (sizeof (gchar *) * INVENIO_CATEGORIES);
+
+        for (i = 0; i < INVENIO_CATEGORIES; i++)
+            category_precedence[i] = invenio_category_to_string (InvenioConfigurationCategoryPrecedence[i]);
+
+        g_key_file_set_string_list (keyfile,
+                                    INVENIO_CONFIGURATION_SEARCH,
+                                    INVENIO_CONFIGURATION_CATEGORY_PRECEDENCE,
+                                    category_precedence,
+                                    INVENIO_CATEGORIES);
+        g_key_file_set_comment (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_CATEGORY_PRECEDENCE,
+                                INVENIO_CONFIGURATION_CATEGORY_PRECEDENCE_COMMENT,
+                                NULL);
+        dirty = TRUE;
+
+        g_free (category_precedence);
+    }
+
+    if (! g_key_file_has_key (keyfile,
+                              INVENIO_CONFIGURATION_SEARCH,
+                              INVENIO_CONFIGURATION_WARM_HIDE,
+                              NULL))
+    {
+        g_key_file_set_comment (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_WARM_HIDE,
+                                INVENIO_CONFIGURATION_WARM_HIDE_COMMENT,
+                                NULL);
+        g_key_file_set_boolean (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_WARM_HIDE,
+                                INVENIO_CONFIGURATION_WARM_HIDE_VALUE);
+        dirty = TRUE;
+    }
+
+    if (! g_key_file_has_key (keyfile,
+                              INVENIO_CONFIGURATION_SEARCH,
+                              INVENIO_CONFIGURATION_STALENESS_THRESHOLD,
+                              NULL))
+    {
+        g_key_file_set_comment (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_STALENESS_THRESHOLD,
+                                INVENIO_CONFIGURATION_STALENESS_THRESHOLD_COMMENT,
+                                NULL);
+        g_key_file_set_integer (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_STALENESS_THRESHOLD,
+                                INVENIO_CONFIGURATION_STALENESS_THRESHOLD_VALUE);
+        dirty = TRUE;
+    }
+
+    if (! g_key_file_has_key (keyfile,
+                              INVENIO_CONFIGURATION_SEARCH,
+                              INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY,
+                              NULL))
+    {
+        g_key_file_set_comment (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY,
+                                INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY_COMMENT,
+                                NULL);
+        g_key_file_set_integer (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY,
+                                INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY_VALUE);
+        dirty = TRUE;
+    }
+
+    if (! g_key_file_has_key (keyfile,
+                              INVENIO_CONFIGURATION_SEARCH,
+                              INVENIO_CONFIGURATION_QUERY_TIMEOUT,
+                              NULL))
+    {
+        g_key_file_set_comment (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_QUERY_TIMEOUT,
+                                INVENIO_CONFIGURATION_QUERY_TIMEOUT_COMMENT,
+                                NULL);
+        g_key_file_set_integer (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_QUERY_TIMEOUT,
+                                INVENIO_CONFIGURATION_QUERY_TIMEOUT_VALUE);
+        dirty = TRUE;
+    }
+
+    if (! g_key_file_has_key (keyfile,
+                              INVENIO_CONFIGURATION_SEARCH,
+                              INVENIO_CONFIGURATION_BEST_MATCHES,
+                              NULL))
+    {
+        g_key_file_set_integer (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_BEST_MATCHES,
+                                INVENIO_CONFIGURATION_BEST_MATCHES_VALUE);
+        g_key_file_set_comment (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_BEST_MATCHES,
+                                INVENIO_CONFIGURATION_BEST_MATCHES_COMMENT,
+                                NULL);
+        dirty = TRUE;
+    }
+
+    if (! g_key_file_has_key (keyfile,
+                              INVENIO_CONFIGURATION_HISTORY,
+                              INVENIO_CONFIGURATION_HISTORY_SIZE,
+                              NULL))
+    {
+        g_key_file_set_integer (keyfile,
+                                INVENIO_CONFIGURATION_HISTORY,
+                                INVENIO_CONFIGURATION_HISTORY_SIZE,
+                                INVENIO_CONFIGURATION_HISTORY_SIZE_VALUE);
+        g_key_file_set_comment (keyfile,
+                                INVENIO_CONFIGURATION_HISTORY,
+                                INVENIO_CONFIGURATION_HISTORY_SIZE,
+                                INVENIO_CONFIGURATION_HISTORY_SIZE_COMMENT,
+                                NULL);
+        dirty = TRUE;
+    }
+
+    if (! g_key_file_has_key (keyfile,
+                              INVENIO_CONFIGURATION_HISTORY,
+                              INVENIO_CONFIGURATION_HISTORY_HALF_LIFE,
+                              NULL))
+    {
+        g_key_file_set_integer (keyfile,
+                                INVENIO_CONFIGURATION_HISTORY,
+                                INVENIO_CONFIGURATION_HISTORY_HALF_LIFE,
+                                INVENIO_CONFIGURATION_HISTORY_HALF_LIFE_VALUE);
+        g_key_file_set_comment (keyfile,
+                                INVENIO_CONFIGURATION_HISTORY,
+                                INVENIO_CONFIGURATION_HISTORY_HALF_LIFE,
+                                INVENIO_CONFIGURATION_HISTORY_HALF_LIFE_COMMENT,
+                                NULL);
+        dirty = TRUE;
+    }
+
+    if (! g_key_file_has_key (keyfile,
+                              INVENIO_CONFIGURATION_HISTORY,
+                              INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS,
+                              NULL))
+    {
+        g_key_file_set_integer (keyfile,
+                                INVENIO_CONFIGURATION_HISTORY,
+                                INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS,
+                                INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS_VALUE);
+        g_key_file_set_comment (keyfile,
+                                INVENIO_CONFIGURATION_HISTORY,
+                                INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS,
+                                INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS_COMMENT,
+                                NULL);
+        dirty = TRUE;
+    }
+
+    return dirty;
 }
 
-void
-invenio_configuration_load (void)
+static gint
+_load_integer (GKeyFile             *keyfile,
+               const gchar * const   group,
+               const gchar * const   key,
+               const gint            minimum,
+               const gint            maximum,
+               const gint            fallback)
 {
-    gchar **search_categories, **category;
-    gchar *directory, *filename;
     GError *error = NULL;
+    gint value;
+
+    value = g_key_file_get_integer (keyfile, group, key, &error);
+
+    if (error)
+    {
+        if (! g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)
+            && ! g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_GROUP_NOT_FOUND))
+            g_warning ("Invalid value for %s/%s: %s", group, key, error->message);
+
+        g_error_free (error);
+        return fallback;
+    }
+
+    if (value < minimum || value > maximum)
+    {
+        g_warning ("Value for %s/%s must be between %d and %d", group, key, minimum, maximum);
+        return fallback;
+    }
+
+    return value;
+}
+
+/* reads a list of categories, any missing ones follow in their default order */
+static void
+_load_categories (GKeyFile              *keyfile,
+                  const gchar * const    key,
+                  InvenioCategory       *categories,
+                  const InvenioCategory *defaults)
+{
+    gboolean seen[INVENIO_CATEGORIES] = { FALSE, };
+    gchar **names, **name;
+    InvenioCategory category;
     gsize entries;
+    guint i = 0, j;
 
-    directory = g_build_filename (g_get_user_config_dir (), "invenio", NULL);
+    names = g_key_file_get_string_list (keyfile,
+                                        INVENIO_CONFIGURATION_SEARCH,
+                                        key,
+                                        &entries,
+                                        NULL);
 
-    if (! g_file_test (directory, G_FILE_TEST_EXISTS))
+    for (name = names; entries && *name; name++, entries--)
     {
-        if (g_mkdir_with_parents (directory, 0700) == -1)
+        category = invenio_category_from_string (*name);
+
+        if (category == INVENIO_CATEGORIES || seen[category])
+            continue;
+
+        seen[category] = TRUE;
+        categories[i++] = category;
+    }
+
+    for (j = 0; j < INVENIO_CATEGORIES; j++)
+    {
+        category = defaults ? defaults[j] : (InvenioCategory) j;
+
+        if (! seen[category])
+            categories[i++] = category;
+    }
+
+    g_strfreev (names);
+}
+
+static InvenioConfigurationSnapshot *
+_parse (GKeyFile *keyfile)
+{
+    InvenioConfigurationSnapshot *snapshot;
+    gchar **search_categories, **name;
+    InvenioCategory category;
+    const gchar *group;
+    gint limit, timeout;
+    gsize entries;
+
+    snapshot = g_slice_new0 (InvenioConfigurationSnapshot);
+    snapshot->ref_count = 1;
+
+    snapshot->menu_shortcut =
+        g_key_file_get_string (keyfile,
+                               INVENIO_CONFIGURATION_GENERAL,
+                               INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY,
+                               NULL);
+
+    search_categories = g_key_file_get_string_list (keyfile,
+                                                    INVENIO_CONFIGURATION_SEARCH,
+                                                    INVENIO_CONFIGURATION_SEARCH_CATEGORIES,
+                                                    &entries,
+                                                    NULL);
+
+    for (name = search_categories; entries && *name; name++, entries--)
+    {
+        category = invenio_category_from_string (*name);
+
+        if (category == INVENIO_CATEGORIES)
         {
-            g_critical ("Could not create configuration directory");
-            g_free (directory);
-            return;
+            g_warning ("Ignoring unknown search category '%s'", *name);
+            continue;
         }
+
+        snapshot->category_enabled[category] = TRUE;
     }
 
+    g_strfreev (search_categories);
+
+    _load_categories (keyfile, INVENIO_CONFIGURATION_CATEGORY_ORDER,
+                      snapshot->category_order, NULL);
+    _load_categories (keyfile, INVENIO_CONFIGURATION_CATEGORY_PRECEDENCE,
+                      snapshot->category_precedence, InvenioConfigurationCategoryPrecedence);
+
+    snapshot->warm_hide =
+        g_key_file_get_boolean (keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_WARM_HIDE,
+                                NULL);
+
+    snapshot->staleness_threshold =
+        _load_integer (keyfile,
+                       INVENIO_CONFIGURATION_SEARCH,
+                       INVENIO_CONFIGURATION_STALENESS_THRESHOLD,
+                       0, G_MAXINT,
+                       INVENIO_CONFIGURATION_STALENESS_THRESHOLD_VALUE);
+
+    limit = _load_integer (keyfile,
+                           INVENIO_CONFIGURATION_SEARCH,
+                           INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY,
+                           1, INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY_MAX,
+                           INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY_VALUE);
+
+    timeout = _load_integer (keyfile,
+                             INVENIO_CONFIGURATION_SEARCH,
+                             INVENIO_CONFIGURATION_QUERY_TIMEOUT,
+                             0, G_MAXINT,
+                             INVENIO_CONFIGURATION_QUERY_TIMEOUT_VALUE);
+
+    snapshot->best_matches =
+        _load_integer (keyfile,
+                       INVENIO_CONFIGURATION_SEARCH,
+                       INVENIO_CONFIGURATION_BEST_MATCHES,
+                       0, INVENIO_CONFIGURATION_BEST_MATCHES_MAX,
+                       INVENIO_CONFIGURATION_BEST_MATCHES_VALUE);
+
+    snapshot->history_size =
+        _load_integer (keyfile,
+                       INVENIO_CONFIGURATION_HISTORY,
+                       INVENIO_CONFIGURATION_HISTORY_SIZE,
+                       1, INVENIO_CONFIGURATION_HISTORY_SIZE_MAX,
+                       INVENIO_CONFIGURATION_HISTORY_SIZE_VALUE);
+
+    snapshot->history_half_life =
+        _load_integer (keyfile,
+                       INVENIO_CONFIGURATION_HISTORY,
+                       INVENIO_CONFIGURATION_HISTORY_HALF_LIFE,
+                       1, G_MAXINT,
+                       INVENIO_CONFIGURATION_HISTORY_HALF_LIFE_VALUE);
+
+    snapshot->history_suggestions =
+        _load_integer (keyfile,
+                       INVENIO_CONFIGURATION_HISTORY,
+                       INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS,
+                       0, INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS_MAX,
+                       INVENIO_CONFIGURATION_HISTORY_SUGGESTIONS_VALUE);
+
+    /* per-category overrides live in a group named after the category */
+    for (category = (InvenioCategory) 0; category != INVENIO_CATEGORIES; category++)
+    {
+        group = invenio_category_to_string (category);
+
+        snapshot->category_limit[category] =
+            _load_integer (keyfile, group, INVENIO_CONFIGURATION_CATEGORY_LIMIT,
+                           1, INVENIO_CONFIGURATION_RESULTS_PER_CATEGORY_MAX, limit);
+        snapshot->category_timeout[category] =
+            _load_integer (keyfile, group, INVENIO_CONFIGURATION_CATEGORY_TIMEOUT,
+                           0, G_MAXINT, timeout);
+    }
+
+    return snapshot;
+}
+
+static InvenioConfigurationSnapshot *
+_snapshot_copy (const InvenioConfigurationSnapshot * const snapshot)
+{
+    InvenioConfigurationSnapshot *copy;
+
+    copy = g_slice_dup (InvenioConfigurationSnapshot, snapshot);
+    copy->menu_shortcut = g_strdup (snapshot->menu_shortcut);
+    copy->ref_count = 1;
+
+    return copy;
+}
+
+const InvenioConfigurationSnapshot *
+invenio_configuration_snapshot_ref (const InvenioConfigurationSnapshot *snapshot)
+{
+    g_atomic_int_inc (&((InvenioConfigurationSnapshot *) snapshot)->ref_count);
+    return snapshot;
+}
+
+void
+invenio_configuration_snapshot_unref (const InvenioConfigurationSnapshot *snapshot)
+{
+    InvenioConfigurationSnapshot *self;
+
+    self = (InvenioConfigurationSnapshot *) snapshot;
+
+    if (! self || ! g_atomic_int_dec_and_test (&self->ref_count))
+        return;
+
+    g_free (self->menu_shortcut);
+    g_slice_free (InvenioConfigurationSnapshot, self);
+}
+
+static InvenioConfigurationChange
+_snapshot_compare (const InvenioConfigurationSnapshot * const previous,
+                   const InvenioConfigurationSnapshot * const current)
+{
+    InvenioConfigurationChange changes = 0;
+
+    if (g_strcmp0 (previous->menu_shortcut, current->menu_shortcut))
+        changes |= INVENIO_CONFIGURATION_CHANGE_MENU_SHORTCUT;
+
+    if (memcmp (previous->category_enabled, current->category_enabled,
+                sizeof (current->category_enabled)))
+        changes |= INVENIO_CONFIGURATION_CHANGE_SEARCH_CATEGORIES;
+
+    if (memcmp (previous->category_order, current->category_order,
+                sizeof (current->category_order)))
+        changes |= INVENIO_CONFIGURATION_CHANGE_CATEGORY_ORDER;
+
+    if (previous->warm_hide != current->warm_hide
+        || previous->staleness_threshold != current->staleness_threshold
+        || previous->best_matches != current->best_matches
+        || memcmp (previous->category_precedence, current->category_precedence,
+                   sizeof (current->category_precedence))
+        || memcmp (previous->category_limit, current->category_limit,
+                   sizeof (current->category_limit))
+        || memcmp (previous->category_timeout, current->category_timeout,
+                   sizeof (current->category_timeout)))
+        changes |= INVENIO_CONFIGURATION_CHANGE_SEARCH;
+
+    if (previous->history_size != current->history_size
+        || previous->history_half_life != current->history_half_life
+        || previous->history_suggestions != current->history_suggestions)
+        changes |= INVENIO_CONFIGURATION_CHANGE_HISTORY;
+
+    return changes;
+}
+
+/* installs a new snapshot, taking over the reference, and notifies watchers */
+static void
+_snapshot_swap (InvenioConfigurationSnapshot *snapshot)
+{
+    InvenioConfigurationSnapshot *previous;
+    InvenioConfigurationChange changes;
+    InvenioConfigurationWatch *watch;
+    GSList *iter;
+
+    previous = configuration.snapshot;
+    configuration.snapshot = snapshot;
+
+    if (! previous)
+        return;
+
+    changes = _snapshot_compare (previous, snapshot);
+
+    for (iter = configuration.watches; changes && iter; iter = iter->next)
+    {
+        watch = (InvenioConfigurationWatch *) iter->data;
+        watch->callback (changes, watch->user_data);
+    }
+
+    invenio_configuration_snapshot_unref (previous);
+}
+
+void
+invenio_configuration_load (void)
+{
+    gchar *directory, *filename;
+    GError *error = NULL;
+
+    directory = g_build_filename (g_get_user_config_dir (), "invenio", NULL);
+
+    /* without the directory the defaults still apply; only saving fails */
+    if (! g_file_test (directory, G_FILE_TEST_EXISTS)
+        && g_mkdir_with_parents (directory, 0700) == -1)
+        g_warning ("Could not create configuration directory");
+
     filename = g_build_filename (directory, INVENIO_CONFIGURATION_KEYFILE, NULL);
 
     if (! configuration.loaded)
@@ -152,69 +737,515 @@ invenio_configuration_load (void)
         g_error_free (error);
 
 
-    _load_defaults ();
+    if (_load_defaults (configuration.keyfile))
+        configuration.dirty = TRUE;
 
+    _snapshot_swap (_parse (configuration.keyfile));
 
-    search_categories = g_key_file_get_string_list (configuration.keyfile,
-                                                    INVENIO_CONFIGURATION_SEARCH,
-                                                    INVENIO_CONFIGURATION_SEARCH_CATEGORIES,
-                                                    &entries,
-                                                    NULL);
+    g_free (filename);
+    g_free (directory);
+}
 
-    for (category = search_categories; entries && *category; category++, entries--)
-        configuration.cache.category_enabled[invenio_category_from_string (*category)] = TRUE;
+static void
+_reload_free (InvenioConfigurationReload *reload)
+{
+    if (reload->keyfile)
+        g_key_file_free (reload->keyfile);
+    invenio_configuration_snapshot_unref (reload->snapshot);
 
+    g_slice_free (InvenioConfigurationReload, reload);
+}
 
-    g_strfreev (search_categories);
+static void
+_reload_thread (GTask           *task,
+                gpointer         source_object,
+                gpointer         task_data,
+                GCancellable    *cancellable)
+{
+    InvenioConfigurationReload *reload;
+    GError *error = NULL;
 
-    g_free (filename);
-    g_free (directory);
+    reload = g_slice_new0 (InvenioConfigurationReload);
+    reload->keyfile = g_key_file_new ();
+
+    if (! g_key_file_load_from_file (reload->keyfile, (const gchar *) task_data,
+                                     G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS,
+                                     &error))
+    {
+        _reload_free (reload);
+        g_task_return_error (task, error);
+        return;
+    }
+
+    _load_defaults (reload->keyfile);
+    reload->snapshot = _parse (reload->keyfile);
+
+    g_task_return_pointer (task, reload, (GDestroyNotify) _reload_free);
 }
 
-gchar *
-invenio_configuration_get_menu_shortcut (void)
+static void _reload (void);
+
+/* copies the settings changed here but not yet saved into a reloaded key file */
+static void
+_reapply_unsaved (GKeyFile *keyfile)
 {
-    return g_key_file_get_string (configuration.keyfile,
-                                  INVENIO_CONFIGURATION_GENERAL,
-                                  INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY,
-                                  NULL);
+    const InvenioConfigurationSetting *setting;
+    gchar *value;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (InvenioConfigurationSettings); i++)
+    {
+        setting = &InvenioConfigurationSettings[i];
+
+        if (! (configuration.unsaved & setting->change))
+            continue;
+
+        value = g_key_file_get_value (configuration.keyfile, setting->group, setting->key, NULL);
+        if (value)
+            g_key_file_set_value (keyfile, setting->group, setting->key, value);
+        g_free (value);
+    }
 }
 
-gboolean
-invenio_configuration_get_search_category (const InvenioCategory category)
+static void
+_reload_ready (GObject      *source_object,
+               GAsyncResult *result,
+               gpointer      user_data)
 {
-    return configuration.cache.category_enabled[category];
+    InvenioConfigurationReload *reload;
+    GError *error = NULL;
+
+    configuration.reloading = FALSE;
+
+    reload = g_task_propagate_pointer (G_TASK (result), &error);
+
+    if (error)
+    {
+        /* the file may be in the middle of being replaced, keep the current values */
+        g_debug ("Unable to reload configuration: %s", error->message);
+        g_error_free (error);
+    }
+    else
+    {
+        /*
+         * The snapshot was built entirely off the main thread; readers only
+         * ever observe either the previous or the new one.  Changes made here
+         * which are not on disk yet are kept on top of what was read, and
+         * are written out with the rest of the file.
+         */
+        if (configuration.unsaved)
+        {
+            _reapply_unsaved (reload->keyfile);
+
+            invenio_configuration_snapshot_unref (reload->snapshot);
+            reload->snapshot = _parse (reload->keyfile);
+        }
+
+        g_key_file_free (configuration.keyfile);
+        configuration.keyfile = reload->keyfile;
+        reload->keyfile = NULL;
+
+        _snapshot_swap (reload->snapshot);
+        reload->snapshot = NULL;
+
+        _reload_free (reload);
+    }
+
+    if (configuration.reload_pending)
+    {
+        configuration.reload_pending = FALSE;
+        _reload ();
+    }
+}
+
+static void
+_reload (void)
+{
+    GTask *task;
+
+    /* coalesce bursts of change events into at most one more reload */
+    if (configuration.reloading)
+    {
+        configuration.reload_pending = TRUE;
+        return;
+    }
+
+    configuration.reloading = TRUE;
+
+    task = g_task_new (NULL, NULL, _reload_ready, NULL);
+    g_task_set_task_data (task, g_file_get_path (configuration.file), g_free);
+    g_task_run_in_thread (task, _reload_thread);
+    g_object_unref (task);
+}
+
+static void
+_file_changed (GFileMonitor     *monitor,
+               GFile            *file,
+               GFile            *other_file,
+               GFileMonitorEvent event_type,
+               gpointer          user_data)
+{
+    switch (event_type)
+    {
+        case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        case G_FILE_MONITOR_EVENT_CREATED:
+            _reload ();
+            break;
+        default:
+            break;
+    }
 }
 
 void
-invenio_configuration_save (void)
+invenio_configuration_monitor (void)
 {
     GError *error = NULL;
-    gchar *filename, *data;
-    gsize size;
 
-    if (! configuration.dirty)
+    g_return_if_fail (configuration.loaded);
+
+    if (configuration.monitor)
         return;
 
-    data = g_key_file_to_data (configuration.keyfile, &size, &error);
+    configuration.monitor = g_file_monitor_file (configuration.file,
+                                                 G_FILE_MONITOR_NONE,
+                                                 NULL,
+                                                 &error);
     if (error)
     {
-        g_warning ("Unable to save configuration: %s", error->message);
+        g_warning ("Unable to monitor configuration: %s", error->message);
         g_error_free (error);
         return;
     }
 
-    filename = g_file_get_path (configuration.file);
+    g_signal_connect (G_OBJECT (configuration.monitor), "changed",
+                      G_CALLBACK (_file_changed), NULL);
+}
+
+void
+invenio_configuration_add_notify (InvenioConfigurationNotify    callback,
+                                  gpointer                      user_data)
+{
+    InvenioConfigurationWatch *watch;
+
+    watch = g_slice_new (InvenioConfigurationWatch);
+    watch->callback = callback;
+    watch->user_data = user_data;
+
+    configuration.watches = g_slist_append (configuration.watches, watch);
+}
+
+const InvenioConfigurationSnapshot *
+invenio_configuration_get_snapshot (void)
+{
+    return configuration.snapshot;
+}
+
+/*
+ * The setters below update the key file and the snapshot, returning whether
+ * anything changed.  The public setters also mark the configuration for
+ * saving; the apply variants do not, for a process which is told of changes
+ * another one has made and will write itself.
+ */
+static gboolean
+_update_menu_shortcut (const gchar * const menu_shortcut)
+{
+    InvenioConfigurationSnapshot *snapshot;
+
+    if (g_strcmp0 (configuration.snapshot->menu_shortcut, menu_shortcut) == 0)
+        return FALSE;
+
+    snapshot = _snapshot_copy (configuration.snapshot);
+    g_free (snapshot->menu_shortcut);
+    snapshot->menu_shortcut = g_strdup (menu_shortcut);
+
+    g_key_file_set_string (configuration.keyfile,
+                           INVENIO_CONFIGURATION_GENERAL,
+                           INVENIO_CONFIGURATION_MENU_SHORTCUT_KEY,
+                           menu_shortcut);
+
+    _snapshot_swap (snapshot);
+
+    return TRUE;
+}
+
+static gboolean
+_update_search_category (const InvenioCategory  category,
+                         const gboolean         enabled)
+{
+    InvenioConfigurationSnapshot *snapshot;
+    const gchar **search_categories;
+    InvenioCategory other;
+    gsize entries = 0;
+
+    if (configuration.snapshot->category_enabled[category] == enabled)
+        return FALSE;
+
+    snapshot = _snapshot_copy (configuration.snapshot);
+    snapshot->category_enabled[category] = enabled;
+
+    search_categories = g_malloc0 (sizeof (gchar *) * INVENIO_CATEGORIES);
+
+    for (other = (InvenioCategory) 0; other != INVENIO_CATEGORIES; other++)
+        if (snapshot->category_enabled[other])
+            search_categories[entries++] = invenio_category_to_string (other);
+
+    g_key_file_set_string_list (configuration.keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_SEARCH_CATEGORIES,
+                                search_categories,
+                                entries);
+
+    _snapshot_swap (snapshot);
+
+    g_free (search_categories);
+
+    return TRUE;
+}
+
+static gboolean
+_update_category_order (const InvenioCategory * const order)
+{
+    InvenioConfigurationSnapshot *snapshot;
+    const gchar **category_order;
+    guint i;
+
+    if (memcmp (configuration.snapshot->category_order, order,
+                sizeof (configuration.snapshot->category_order)) == 0)
+        return FALSE;
+
+    /* snapshots are immutable, so install an updated copy */
+    snapshot = _snapshot_copy (configuration.snapshot);
+    category_order = g_malloc0 (sizeof (gchar *) * INVENIO_CATEGORIES);
+
+    for (i = 0; i < INVENIO_CATEGORIES; i++)
+    {
+        snapshot->category_order[i] = order[i];
+        category_order[i] = invenio_category_to_string (order[i]);
+    }
+
+    g_key_file_set_string_list (configuration.keyfile,
+                                INVENIO_CONFIGURATION_SEARCH,
+                                INVENIO_CONFIGURATION_CATEGORY_ORDER,
+                                category_order,
+                                INVENIO_CATEGORIES);
+
+    _snapshot_swap (snapshot);
+
+    g_free (category_order);
+
+    return TRUE;
+}
 
-    g_file_set_contents (filename, data, size, &error);
+void
+invenio_configuration_set_menu_shortcut (const gchar * const menu_shortcut)
+{
+    if (_update_menu_shortcut (menu_shortcut))
+    {
+        configuration.dirty = TRUE;
+        configuration.unsaved |= INVENIO_CONFIGURATION_CHANGE_MENU_SHORTCUT;
+    }
+}
+
+void
+invenio_configuration_set_search_category (const InvenioCategory  category,
+                                           const gboolean         enabled)
+{
+    if (_update_search_category (category, enabled))
+    {
+        configuration.dirty = TRUE;
+        configuration.unsaved |= INVENIO_CONFIGURATION_CHANGE_SEARCH_CATEGORIES;
+    }
+}
+
+void
+invenio_configuration_set_category_order (const InvenioCategory * const order)
+{
+    if (_update_category_order (order))
+    {
+        configuration.dirty = TRUE;
+        configuration.unsaved |= INVENIO_CONFIGURATION_CHANGE_CATEGORY_ORDER;
+    }
+}
+
+void
+invenio_configuration_apply_menu_shortcut (const gchar * const menu_shortcut)
+{
+    _update_menu_shortcut (menu_shortcut);
+}
+
+void
+invenio_configuration_apply_search_category (const InvenioCategory  category,
+                                             const gboolean         enabled)
+{
+    _update_search_category (category, enabled);
+}
+
+void
+invenio_configuration_apply_category_order (const InvenioCategory * const order)
+{
+    _update_category_order (order);
+}
+
+static InvenioConfigurationWrite *
+_write_new (void)
+{
+    InvenioConfigurationWrite *write;
+    GError *error = NULL;
+    gchar *data;
+    gsize size;
+
+    data = g_key_file_to_data (configuration.keyfile, &size, &error);
     if (error)
     {
         g_warning ("Unable to save configuration: %s", error->message);
         g_error_free (error);
-        /* fall-through */
+        return NULL;
     }
 
-    g_free (data);
-    g_free (filename);
+    write = g_slice_new0 (InvenioConfigurationWrite);
+    write->filename = g_file_get_path (configuration.file);
+    write->data = data;
+    write->size = size;
+    write->generation = ++configuration.generation;
+
+    configuration.dirty = FALSE;
+
+    return write;
+}
+
+static void
+_write_free (InvenioConfigurationWrite *write)
+{
+    g_free (write->filename);
+    g_free (write->data);
+    g_slice_free (InvenioConfigurationWrite, write);
 }
 
+static gboolean
+_write (InvenioConfigurationWrite    *write,
+        GError                      **error)
+{
+    gboolean success = TRUE;
+
+    g_mutex_lock (&writer_lock);
+
+    /* a newer serialization has already reached the disk */
+    if (write->generation > written)
+    {
+        success = g_file_set_contents (write->filename, write->data, write->size, error);
+        if (success)
+            written = write->generation;
+    }
+
+    g_mutex_unlock (&writer_lock);
+
+    return success;
+}
+
+static void
+_write_thread (GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    if (_write ((InvenioConfigurationWrite *) task_data, &error))
+        g_task_return_boolean (task, TRUE);
+    else
+        g_task_return_error (task, error);
+}
+
+static void
+_write_ready (GObject       *source_object,
+              GAsyncResult  *result,
+              gpointer       user_data)
+{
+    GError *error = NULL;
+
+    configuration.writes--;
+
+    if (! g_task_propagate_boolean (G_TASK (result), &error))
+    {
+        g_warning ("Unable to save configuration: %s", error->message);
+        g_error_free (error);
+
+        /* keep the changes around for the next save or the final flush */
+        configuration.dirty = TRUE;
+    }
+    else if (! configuration.writes && ! configuration.dirty)
+    {
+        configuration.unsaved = 0;
+    }
+}
+
+static gboolean
+_save_timeout (gpointer user_data)
+{
+    InvenioConfigurationWrite *write;
+    GTask *task;
+
+    configuration.save_id = 0;
+
+    if (! configuration.dirty)
+        return G_SOURCE_REMOVE;
+
+    /*
+     * The key file is only ever touched on the main thread, so serialize it
+     * here and leave the (fsync'ing) write to a worker.
+     */
+    write = _write_new ();
+    if (! write)
+        return G_SOURCE_REMOVE;
+
+    configuration.writes++;
+
+    task = g_task_new (NULL, NULL, _write_ready, NULL);
+    g_task_set_task_data (task, write, (GDestroyNotify) _write_free);
+    g_task_run_in_thread (task, _write_thread);
+    g_object_unref (task);
+
+    return G_SOURCE_REMOVE;
+}
+
+void
+invenio_configuration_save (void)
+{
+    if (! configuration.dirty || configuration.save_id)
+        return;
+
+    /* coalesce changes made in quick succession into a single write */
+    configuration.save_id = g_timeout_add (INVENIO_CONFIGURATION_SAVE_DELAY,
+                                           _save_timeout, NULL);
+}
+
+void
+invenio_configuration_flush (void)
+{
+    InvenioConfigurationWrite *write;
+    GError *error = NULL;
+
+    if (configuration.save_id)
+    {
+        g_source_remove (configuration.save_id);
+        configuration.save_id = 0;
+    }
+
+    if (configuration.dirty && (write = _write_new ()))
+    {
+        if (! _write (write, &error))
+        {
+            g_warning ("Unable to save configuration: %s", error->message);
+            g_error_free (error);
+        }
+
+        _write_free (write);
+    }
+
+    /* wait for the writes still in flight */
+    while (configuration.writes)
+        g_main_context_iteration (NULL, TRUE);
+
+    if (! configuration.dirty)
+        configuration.unsaved = 0;
+}
@@ -35,17 +35,80 @@
 
 #include "invenio-category.h"
 
+typedef enum InvenioConfigurationChange
+{
+    INVENIO_CONFIGURATION_CHANGE_MENU_SHORTCUT      = 1 << 0,
+    INVENIO_CONFIGURATION_CHANGE_SEARCH_CATEGORIES  = 1 << 1,
+    INVENIO_CONFIGURATION_CHANGE_CATEGORY_ORDER     = 1 << 2,
+    INVENIO_CONFIGURATION_CHANGE_SEARCH             = 1 << 3,
+    INVENIO_CONFIGURATION_CHANGE_HISTORY            = 1 << 4,
+} InvenioConfigurationChange;
+
+typedef struct InvenioConfigurationSnapshot
+{
+    gchar           *menu_shortcut;
+    gboolean         category_enabled[INVENIO_CATEGORIES];
+    InvenioCategory  category_order[INVENIO_CATEGORIES];
+    InvenioCategory  category_precedence[INVENIO_CATEGORIES];
+    guint            category_limit[INVENIO_CATEGORIES];
+    guint            category_timeout[INVENIO_CATEGORIES];
+    gboolean         warm_hide;
+    guint            staleness_threshold;
+    guint            best_matches;
+    guint            history_size;
+    guint            history_half_life;
+    guint            history_suggestions;
+
+    /*< private >*/
+    volatile gint    ref_count;
+} InvenioConfigurationSnapshot;
+
+typedef void (*InvenioConfigurationNotify)(const InvenioConfigurationChange changes, gpointer user_data);
+
 void
 invenio_configuration_load (void);
 
-gchar *
-invenio_configuration_get_menu_shortcut (void);
+void
+invenio_configuration_monitor (void);
+
+void
+invenio_configuration_add_notify (InvenioConfigurationNotify    callback,
+                                  gpointer                      user_data);
+
+const InvenioConfigurationSnapshot *
+invenio_configuration_get_snapshot (void);
+
+const InvenioConfigurationSnapshot *
+invenio_configuration_snapshot_ref (const InvenioConfigurationSnapshot *snapshot);
+
+void
+invenio_configuration_snapshot_unref (const InvenioConfigurationSnapshot *snapshot);
+
+void
+invenio_configuration_set_menu_shortcut (const gchar * const menu_shortcut);
+
+void
+invenio_configuration_set_search_category (const InvenioCategory  category,
+                                           const gboolean         enabled);
+
+void
+invenio_configuration_set_category_order (const InvenioCategory * const order);
+
+void
+invenio_configuration_apply_menu_shortcut (const gchar * const menu_shortcut);
+
+void
+invenio_configuration_apply_search_category (const InvenioCategory  category,
+                                             const gboolean         enabled);
 
-gboolean
-invenio_configuration_get_search_category (const InvenioCategory category);
+void
+invenio_configuration_apply_category_order (const InvenioCategory * const order);
 
 void
 invenio_configuration_save (void);
 
+void
+invenio_configuration_flush (void);
+
 #endif
 
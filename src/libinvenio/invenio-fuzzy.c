@@ -0,0 +1,559 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#include <string.h>
+
+#include "invenio-fuzzy.h"
+#include "invenio-normalize.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define INVENIO_FUZZY_HAVE_SSE2
+#include <emmintrin.h>
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define INVENIO_FUZZY_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+/* scoring, after fzf's (v1) */
+#define INVENIO_FUZZY_SCORE_MATCH               (16)
+#define INVENIO_FUZZY_SCORE_GAP_START           (-3)
+#define INVENIO_FUZZY_SCORE_GAP_EXTENSION       (-1)
+#define INVENIO_FUZZY_BONUS_BOUNDARY            (INVENIO_FUZZY_SCORE_MATCH / 2)
+#define INVENIO_FUZZY_BONUS_NON_WORD            (INVENIO_FUZZY_SCORE_MATCH / 2)
+#define INVENIO_FUZZY_BONUS_CAMEL               (INVENIO_FUZZY_BONUS_BOUNDARY + INVENIO_FUZZY_SCORE_GAP_EXTENSION)
+#define INVENIO_FUZZY_BONUS_CONSECUTIVE         (- (INVENIO_FUZZY_SCORE_GAP_START + INVENIO_FUZZY_SCORE_GAP_EXTENSION))
+#define INVENIO_FUZZY_BONUS_FIRST_MULTIPLIER    (2)
+
+
+typedef enum InvenioFuzzyClass
+{
+    INVENIO_FUZZY_CLASS_NON_WORD,
+    INVENIO_FUZZY_CLASS_LOWER,
+    INVENIO_FUZZY_CLASS_UPPER,
+    INVENIO_FUZZY_CLASS_LETTER,
+    INVENIO_FUZZY_CLASS_NUMBER,
+} InvenioFuzzyClass;
+
+/* finds the first byte at or after from which case-insensitively is c */
+typedef gsize (*InvenioFuzzyFind)(const guchar * const text, const gsize length, gsize from, const guchar c);
+
+/*
+ * A text prepared for matching: normalized as the pattern is, with the class
+ * of each position taken from the text as it was, so that word boundaries and
+ * camel case humps survive the folding.  ASCII text is kept as bytes for the
+ * vectorised scan, anything else as characters.
+ */
+struct InvenioFuzzyText
+{
+    guchar          *bytes;
+    gunichar        *characters;
+    guint8          *classes;
+    gsize            length;
+};
+
+struct InvenioFuzzyPattern
+{
+    gboolean         ascii;
+    guchar          *bytes;
+    gunichar        *characters;
+    gsize            length;
+
+    gint             maximum;
+};
+
+
+static inline guchar
+_ascii_lower (const guchar c)
+{
+    return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+static gsize
+_find_scalar (const guchar * const  text,
+              const gsize           length,
+              gsize                 from,
+              const guchar          c)
+{
+    for (; from < length; from++)
+        if (_ascii_lower (text[from]) == c)
+            return from;
+
+    return length;
+}
+
+static gboolean
+_is_ascii_scalar (const guchar * const text,
+                  const gsize          length)
+{
+    gsize i;
+
+    for (i = 0; i < length; i++)
+        if (text[i] & 0x80)
+            return FALSE;
+
+    return TRUE;
+}
+
+#if defined(INVENIO_FUZZY_HAVE_SSE2)
+/*
+ * Lowercases 16 bytes at a time by setting the 0x20 bit of bytes in 'A'..'Z'.
+ * Bytes of multibyte characters are negative as signed bytes and so never
+ * fall in the range, leaving them as they are.
+ */
+static gsize
+_find_sse2 (const guchar * const    text,
+            const gsize             length,
+            gsize                   from,
+            const guchar            c)
+{
+    const __m128i needle = _mm_set1_epi8 ((gchar) c);
+    const __m128i below = _mm_set1_epi8 ('A' - 1);
+    const __m128i above = _mm_set1_epi8 ('Z' + 1);
+    const __m128i fold = _mm_set1_epi8 (0x20);
+    __m128i chunk, upper;
+    gint mask;
+
+    for (; from + 16 <= length; from += 16)
+    {
+        chunk = _mm_loadu_si128 ((const __m128i *) (text + from));
+        upper = _mm_and_si128 (_mm_cmpgt_epi8 (chunk, below), _mm_cmplt_epi8 (chunk, above));
+        chunk = _mm_or_si128 (chunk, _mm_and_si128 (upper, fold));
+
+        if ((mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (chunk, needle))))
+            return from + g_bit_nth_lsf (mask, -1);
+    }
+
+    return _find_scalar (text, length, from, c);
+}
+
+static gboolean
+_is_ascii_sse2 (const guchar * const text,
+                const gsize          length)
+{
+    __m128i bits = _mm_setzero_si128 ();
+    gsize i;
+
+    for (i = 0; i + 16 <= length; i += 16)
+        bits = _mm_or_si128 (bits, _mm_loadu_si128 ((const __m128i *) (text + i)));
+
+    return ! _mm_movemask_epi8 (bits) && _is_ascii_scalar (text + i, length - i);
+}
+#endif
+
+#if defined(INVENIO_FUZZY_HAVE_AVX2)
+__attribute__((target ("avx2")))
+static gsize
+_find_avx2 (const guchar * const    text,
+            const gsize             length,
+            gsize                   from,
+            const guchar            c)
+{
+    const __m256i needle = _mm256_set1_epi8 ((gchar) c);
+    const __m256i below = _mm256_set1_epi8 ('A' - 1);
+    const __m256i above = _mm256_set1_epi8 ('Z' + 1);
+    const __m256i fold = _mm256_set1_epi8 (0x20);
+    __m256i chunk, upper;
+    guint mask;
+
+    for (; from + 32 <= length; from += 32)
+    {
+        chunk = _mm256_loadu_si256 ((const __m256i *) (text + from));
+        upper = _mm256_and_si256 (_mm256_cmpgt_epi8 (chunk, below),
+                                  _mm256_cmpgt_epi8 (above, chunk));
+        chunk = _mm256_or_si256 (chunk, _mm256_and_si256 (upper, fold));
+
+        if ((mask = (guint) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (chunk, needle))))
+            return from + g_bit_nth_lsf (mask, -1);
+    }
+
+    return _find_sse2 (text, length, from, c);
+}
+#endif
+
+static InvenioFuzzyFind
+_get_find (void)
+{
+    static gsize find = 0;
+
+    if (g_once_init_enter (&find))
+    {
+        InvenioFuzzyFind implementation = _find_scalar;
+
+#if defined(INVENIO_FUZZY_HAVE_SSE2)
+        implementation = _find_sse2;
+#endif
+#if defined(INVENIO_FUZZY_HAVE_AVX2)
+        __builtin_cpu_init ();
+        if (__builtin_cpu_supports ("avx2"))
+            implementation = _find_avx2;
+#endif
+
+        g_once_init_leave (&find, (gsize) implementation);
+    }
+
+    return (InvenioFuzzyFind) find;
+}
+
+static gboolean
+_is_ascii (const guchar * const text,
+           const gsize          length)
+{
+#if defined(INVENIO_FUZZY_HAVE_SSE2)
+    return _is_ascii_sse2 (text, length);
+#else
+    return _is_ascii_scalar (text, length);
+#endif
+}
+
+static inline gunichar
+_text_at (const InvenioFuzzyText * const text,
+          const gsize                    index)
+{
+    return text->bytes ? text->bytes[index] : text->characters[index];
+}
+
+static InvenioFuzzyClass
+_classify (const gunichar c)
+{
+    if (c < 0x80)
+    {
+        if (c >= 'a' && c <= 'z')
+            return INVENIO_FUZZY_CLASS_LOWER;
+        if (c >= 'A' && c <= 'Z')
+            return INVENIO_FUZZY_CLASS_UPPER;
+        if (c >= '0' && c <= '9')
+            return INVENIO_FUZZY_CLASS_NUMBER;
+        return INVENIO_FUZZY_CLASS_NON_WORD;
+    }
+
+    if (g_unichar_islower (c))
+        return INVENIO_FUZZY_CLASS_LOWER;
+    if (g_unichar_isupper (c))
+        return INVENIO_FUZZY_CLASS_UPPER;
+    if (g_unichar_isdigit (c))
+        return INVENIO_FUZZY_CLASS_NUMBER;
+    if (g_unichar_isalpha (c))
+        return INVENIO_FUZZY_CLASS_LETTER;
+    return INVENIO_FUZZY_CLASS_NON_WORD;
+}
+
+static gint
+_bonus (const InvenioFuzzyClass previous,
+        const InvenioFuzzyClass current)
+{
+    if (previous == INVENIO_FUZZY_CLASS_NON_WORD && current != INVENIO_FUZZY_CLASS_NON_WORD)
+        return INVENIO_FUZZY_BONUS_BOUNDARY;
+    if ((previous == INVENIO_FUZZY_CLASS_LOWER && current == INVENIO_FUZZY_CLASS_UPPER)
+        || (previous != INVENIO_FUZZY_CLASS_NUMBER && current == INVENIO_FUZZY_CLASS_NUMBER))
+        return INVENIO_FUZZY_BONUS_CAMEL;
+    if (current == INVENIO_FUZZY_CLASS_NON_WORD)
+        return INVENIO_FUZZY_BONUS_NON_WORD;
+    return 0;
+}
+
+/*
+ * Scores the match in [start, end), which begins and ends with a match of the
+ * first and last character of the pattern.  Matches are rewarded, more so at
+ * word boundaries, camel case humps and in runs, while gaps are penalised.
+ */
+static gint
+_score (const InvenioFuzzyPattern * const   pattern,
+        const InvenioFuzzyText * const      text,
+        const gsize                         start,
+        const gsize                         end)
+{
+    InvenioFuzzyClass previous, current;
+    gint score = 0, bonus, first_bonus = 0;
+    guint consecutive = 0;
+    gboolean in_gap = FALSE;
+    gsize index, matched = 0;
+
+    previous = start ? text->classes[start - 1] : INVENIO_FUZZY_CLASS_NON_WORD;
+
+    for (index = start; index < end; index++)
+    {
+        current = text->classes[index];
+
+        if (matched < pattern->length && _text_at (text, index) == pattern->characters[matched])
+        {
+            score += INVENIO_FUZZY_SCORE_MATCH;
+            bonus = _bonus (previous, current);
+
+            if (consecutive == 0)
+            {
+                first_bonus = bonus;
+            }
+            else
+            {
+                /* a run carries the bonus of where it started */
+                if (bonus >= INVENIO_FUZZY_BONUS_BOUNDARY && bonus > first_bonus)
+                    first_bonus = bonus;
+                bonus = MAX (MAX (bonus, first_bonus), INVENIO_FUZZY_BONUS_CONSECUTIVE);
+            }
+
+            score += matched == 0 ? bonus * INVENIO_FUZZY_BONUS_FIRST_MULTIPLIER : bonus;
+
+            in_gap = FALSE;
+            consecutive++;
+            matched++;
+        }
+        else
+        {
+            score += in_gap ? INVENIO_FUZZY_SCORE_GAP_EXTENSION : INVENIO_FUZZY_SCORE_GAP_START;
+
+            in_gap = TRUE;
+            consecutive = 0;
+            first_bonus = 0;
+        }
+
+        previous = current;
+    }
+
+    return score;
+}
+
+static gboolean
+_match_ascii (const InvenioFuzzyPattern * const pattern,
+              const InvenioFuzzyText * const    text,
+              const InvenioFuzzyFind            find,
+              gint                             *score)
+{
+    gsize start, end, index;
+    gssize matched;
+
+    /* forward: the earliest end of a match, found with the vectorised scan */
+    for (index = 0, matched = 0; matched < (gssize) pattern->length; index++, matched++)
+        if ((index = find (text->bytes, text->length, index, pattern->bytes[matched])) == text->length)
+            return FALSE;
+
+    end = index;
+
+    /* backward: the latest start of a match ending there */
+    for (index = end, matched = pattern->length - 1; matched >= 0; matched--)
+        while (text->bytes[--index] != pattern->bytes[matched])
+            ;
+
+    start = index;
+
+    *score = _score (pattern, text, start, end);
+
+    return TRUE;
+}
+
+static gboolean
+_match_utf8 (const InvenioFuzzyPattern * const  pattern,
+             const InvenioFuzzyText * const     text,
+             gint                              *score)
+{
+    gsize start, end, index;
+    gssize matched;
+
+    /* forward */
+    for (index = 0, matched = 0; index < text->length && matched < (gssize) pattern->length; index++)
+        if (text->characters[index] == pattern->characters[matched])
+            matched++;
+
+    if (matched < (gssize) pattern->length)
+        return FALSE;
+
+    end = index;
+
+    /* backward */
+    for (index = end, matched = pattern->length - 1; matched >= 0; matched--)
+        while (text->characters[--index] != pattern->characters[matched])
+            ;
+
+    start = index;
+
+    *score = _score (pattern, text, start, end);
+
+    return TRUE;
+}
+
+InvenioFuzzyPattern *
+invenio_fuzzy_pattern_new (const gchar * const pattern)
+{
+    InvenioFuzzyPattern *fuzzy;
+    gchar *normalized;
+    glong length;
+    gsize i;
+
+    fuzzy = g_slice_new0 (InvenioFuzzyPattern);
+
+    /* the pattern is decoded both ways, as the text decides which is used */
+    normalized = invenio_normalize (pattern);
+
+    fuzzy->characters = g_utf8_to_ucs4_fast (normalized, -1, &length);
+    fuzzy->length = length;
+
+    fuzzy->ascii = _is_ascii ((const guchar *) normalized, strlen (normalized));
+
+    if (fuzzy->ascii)
+    {
+        fuzzy->bytes = g_new (guchar, fuzzy->length);
+        for (i = 0; i < fuzzy->length; i++)
+            fuzzy->bytes[i] = normalized[i];
+    }
+
+    g_free (normalized);
+
+    /* every character matching on a boundary in one run */
+    fuzzy->maximum = fuzzy->length * (INVENIO_FUZZY_SCORE_MATCH + INVENIO_FUZZY_BONUS_BOUNDARY)
+                   + INVENIO_FUZZY_BONUS_BOUNDARY * (INVENIO_FUZZY_BONUS_FIRST_MULTIPLIER - 1);
+
+    return fuzzy;
+}
+
+void
+invenio_fuzzy_pattern_free (InvenioFuzzyPattern *pattern)
+{
+    g_free (pattern->bytes);
+    g_free (pattern->characters);
+    g_slice_free (InvenioFuzzyPattern, pattern);
+}
+
+/*
+ * Characters are normalized one at a time so that each of those they expand
+ * to (or none, for combining marks) keeps the class of the original.
+ */
+InvenioFuzzyText *
+invenio_fuzzy_text_new (const gchar * const text)
+{
+    InvenioFuzzyText *fuzzy;
+    GArray *characters, *classes;
+    gchar buffer[8], *normalized;
+    const gchar *p, *q;
+    guint8 klass;
+    gunichar c;
+    gsize i, length;
+
+    fuzzy = g_slice_new0 (InvenioFuzzyText);
+
+    length = strlen (text);
+
+    if (_is_ascii ((const guchar *) text, length))
+    {
+        fuzzy->bytes = (guchar *) invenio_normalize (text);
+        fuzzy->classes = g_new (guint8, length);
+        fuzzy->length = length;
+
+        for (i = 0; i < length; i++)
+            fuzzy->classes[i] = _classify ((guchar) text[i]);
+
+        return fuzzy;
+    }
+
+    characters = g_array_sized_new (FALSE, FALSE, sizeof (gunichar), length);
+    classes = g_array_sized_new (FALSE, FALSE, sizeof (guint8), length);
+
+    for (p = text; *p; p = g_utf8_next_char (p))
+    {
+        c = g_utf8_get_char (p);
+        klass = _classify (c);
+
+        if (c < 0x80)
+        {
+            c = _ascii_lower (c);
+            g_array_append_val (characters, c);
+            g_array_append_val (classes, klass);
+            continue;
+        }
+
+        buffer[g_unichar_to_utf8 (c, buffer)] = '\0';
+        normalized = invenio_normalize (buffer);
+
+        for (q = normalized; *q; q = g_utf8_next_char (q))
+        {
+            c = g_utf8_get_char (q);
+            g_array_append_val (characters, c);
+            g_array_append_val (classes, klass);
+        }
+
+        g_free (normalized);
+    }
+
+    fuzzy->length = characters->len;
+    fuzzy->characters = (gunichar *) g_array_free (characters, FALSE);
+    fuzzy->classes = (guint8 *) g_array_free (classes, FALSE);
+
+    return fuzzy;
+}
+
+void
+invenio_fuzzy_text_free (InvenioFuzzyText *text)
+{
+    g_free (text->bytes);
+    g_free (text->characters);
+    g_free (text->classes);
+    g_slice_free (InvenioFuzzyText, text);
+}
+
+/* the length of the text in (normalized) characters */
+gsize
+invenio_fuzzy_text_get_length (const InvenioFuzzyText * const text)
+{
+    return text->length;
+}
+
+/*
+ * Whether the pattern is a (case-insensitive) subsequence of the text, and if
+ * so how good a match it is, scaled to (0, 1].  ASCII text is scanned with
+ * SSE2 or AVX2 where available, anything else is matched by character.
+ */
+gboolean
+invenio_fuzzy_pattern_match (const InvenioFuzzyPattern * const pattern,
+                             const InvenioFuzzyText * const    text,
+                             gdouble                          *score)
+{
+    gboolean matched;
+    gint value = 0;
+
+    if (! pattern->length)
+    {
+        if (score)
+            *score = 1.0;
+        return TRUE;
+    }
+
+    if (! text)
+        return FALSE;
+
+    if (text->bytes)
+        /* the normalized pattern cannot match ASCII text unless it is ASCII */
+        matched = pattern->ascii && _match_ascii (pattern, text, _get_find (), &value);
+    else
+        matched = _match_utf8 (pattern, text, &value);
+
+    if (matched && score)
+        *score = CLAMP ((gdouble) MAX (value, 1) / pattern->maximum, G_MINDOUBLE, 1.0);
+
+    return matched;
+}
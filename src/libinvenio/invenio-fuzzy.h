@@ -0,0 +1,60 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#ifndef __INVENIO_FUZZY_H__
+#define __INVENIO_FUZZY_H__
+
+#include <glib.h>
+
+typedef struct InvenioFuzzyPattern InvenioFuzzyPattern;
+typedef struct InvenioFuzzyText InvenioFuzzyText;
+
+InvenioFuzzyPattern *
+invenio_fuzzy_pattern_new (const gchar * const pattern);
+
+void
+invenio_fuzzy_pattern_free (InvenioFuzzyPattern *pattern);
+
+InvenioFuzzyText *
+invenio_fuzzy_text_new (const gchar * const text);
+
+void
+invenio_fuzzy_text_free (InvenioFuzzyText *text);
+
+gsize
+invenio_fuzzy_text_get_length (const InvenioFuzzyText * const text);
+
+gboolean
+invenio_fuzzy_pattern_match (const InvenioFuzzyPattern * const pattern,
+                             const InvenioFuzzyText * const    text,
+                             gdouble                          *score);
+
+#endif
+
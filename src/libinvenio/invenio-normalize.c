@@ -0,0 +1,162 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#include <string.h>
+
+#include "invenio-normalize.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define INVENIO_NORMALIZE_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+
+static inline guchar
+_ascii_lower (const guchar c)
+{
+    return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+/* lowercases text into output, giving up at the first byte which is not ASCII */
+static gboolean
+_lower_ascii_scalar (const guchar * const   text,
+                     guchar * const         output,
+                     gsize                  from,
+                     const gsize            length)
+{
+    for (; from < length; from++)
+    {
+        if (text[from] & 0x80)
+            return FALSE;
+        output[from] = _ascii_lower (text[from]);
+    }
+
+    return TRUE;
+}
+
+#if defined(INVENIO_NORMALIZE_HAVE_SSE2)
+/*
+ * As the scalar version, 16 bytes at a time: a chunk with any high bit set is
+ * not ASCII, otherwise bytes in 'A'..'Z' have their 0x20 bit set.
+ */
+static gboolean
+_lower_ascii_sse2 (const guchar * const text,
+                   guchar * const       output,
+                   const gsize          length)
+{
+    const __m128i below = _mm_set1_epi8 ('A' - 1);
+    const __m128i above = _mm_set1_epi8 ('Z' + 1);
+    const __m128i fold = _mm_set1_epi8 (0x20);
+    __m128i chunk, upper;
+    gsize i;
+
+    for (i = 0; i + 16 <= length; i += 16)
+    {
+        chunk = _mm_loadu_si128 ((const __m128i *) (text + i));
+        if (_mm_movemask_epi8 (chunk))
+            return FALSE;
+
+        upper = _mm_and_si128 (_mm_cmpgt_epi8 (chunk, below), _mm_cmplt_epi8 (chunk, above));
+        _mm_storeu_si128 ((__m128i *) (output + i),
+                          _mm_or_si128 (chunk, _mm_and_si128 (upper, fold)));
+    }
+
+    return _lower_ascii_scalar (text, output, i, length);
+}
+#endif
+
+static gboolean
+_lower_ascii (const guchar * const  text,
+              guchar * const        output,
+              const gsize           length)
+{
+#if defined(INVENIO_NORMALIZE_HAVE_SSE2)
+    return _lower_ascii_sse2 (text, output, length);
+#else
+    return _lower_ascii_scalar (text, output, 0, length);
+#endif
+}
+
+/* compatibility decomposition, without combining marks, casefolded and recomposed */
+static gchar *
+_normalize_utf8 (const gchar * const text)
+{
+    gchar *decomposed, *folded, *normalized;
+    const gchar *p;
+    GString *stripped;
+    gunichar c;
+
+    if (! (decomposed = g_utf8_normalize (text, -1, G_NORMALIZE_ALL)))
+        return g_strdup (text);
+
+    stripped = g_string_sized_new (strlen (decomposed));
+
+    for (p = decomposed; *p; p = g_utf8_next_char (p))
+        if (! g_unichar_ismark (c = g_utf8_get_char (p)))
+            g_string_append_unichar (stripped, c);
+
+    folded = g_utf8_casefold (stripped->str, stripped->len);
+    normalized = g_utf8_normalize (folded, -1, G_NORMALIZE_ALL_COMPOSE);
+
+    g_free (decomposed);
+    g_string_free (stripped, TRUE);
+    g_free (folded);
+
+    return normalized;
+}
+
+/*
+ * Normalizes text as tracker's full text search does: NFKC, casefolded and
+ * with diacritics removed, so that "Écran" and "ecran" compare equal.  Most
+ * titles are ASCII, where this is only lowercasing, and are handled bytewise
+ * without going through GLib's Unicode tables.
+ */
+gchar *
+invenio_normalize (const gchar * const text)
+{
+    gchar *normalized;
+    gsize length;
+
+    if (! text)
+        return NULL;
+
+    length = strlen (text);
+    normalized = g_malloc (length + 1);
+
+    if (_lower_ascii ((const guchar *) text, (guchar *) normalized, length))
+    {
+        normalized[length] = '\0';
+        return normalized;
+    }
+
+    g_free (normalized);
+
+    return _normalize_utf8 (text);
+}
@@ -0,0 +1,326 @@
+/* vim: set et fdm=syntax sts=4 sw=4 ts=4 : */
+/**
+ * Copyright © 2010 Saleem Abdulrasool <compnerd@compnerd.org>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ * 3. The name of the author may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ **/
+
+#include "invenio-remote.h"
+#include "invenio-configuration.h"
+
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+
+#define INVENIO_REMOTE_NAME                 "org.compnerd.Invenio"
+#define INVENIO_REMOTE_PATH                 "/org/compnerd/Invenio"
+#define INVENIO_REMOTE_INTERFACE            "org.compnerd.Invenio.Preferences"
+
+
+static const gchar introspection[] =
+    "<node>"
+    "  <interface name='" INVENIO_REMOTE_INTERFACE "'>"
+    "    <method name='SetMenuShortcut'>"
+    "      <arg type='s' name='shortcut' direction='in'/>"
+    "    </method>"
+    "    <method name='SetSearchCategory'>"
+    "      <arg type='s' name='category' direction='in'/>"
+    "      <arg type='b' name='enabled' direction='in'/>"
+    "    </method>"
+    "    <method name='SetCategoryOrder'>"
+    "      <arg type='as' name='order' direction='in'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+
+static struct
+{
+    guint            owner_id;
+    GDBusNodeInfo   *node_info;
+
+    /* client side */
+    GDBusConnection *connection;
+} remote;
+
+
+static void
+_set_menu_shortcut (GVariant                *parameters,
+                    GDBusMethodInvocation   *invocation)
+{
+    GdkModifierType accelerator_mods;
+    const gchar *menu_shortcut;
+    guint accelerator_key;
+
+    g_variant_get (parameters, "(&s)", &menu_shortcut);
+
+    /* an empty shortcut disables the binding */
+    if (*menu_shortcut)
+    {
+        gtk_accelerator_parse (menu_shortcut, &accelerator_key, &accelerator_mods);
+
+        if (! accelerator_key)
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                                   G_DBUS_ERROR_INVALID_ARGS,
+                                                   "Invalid shortcut '%s'", menu_shortcut);
+            return;
+        }
+    }
+
+    invenio_configuration_apply_menu_shortcut (menu_shortcut);
+    g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static void
+_set_search_category (GVariant              *parameters,
+                      GDBusMethodInvocation *invocation)
+{
+    InvenioCategory category;
+    const gchar *name;
+    gboolean enabled;
+
+    g_variant_get (parameters, "(&sb)", &name, &enabled);
+
+    category = invenio_category_from_string (name);
+
+    if (category == INVENIO_CATEGORIES)
+    {
+        g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                               G_DBUS_ERROR_INVALID_ARGS,
+                                               "Unknown category '%s'", name);
+        return;
+    }
+
+    invenio_configuration_apply_search_category (category, enabled);
+    g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static void
+_set_category_order (GVariant               *parameters,
+                     GDBusMethodInvocation  *invocation)
+{
+    gboolean seen[INVENIO_CATEGORIES] = { FALSE, };
+    InvenioCategory order[INVENIO_CATEGORIES];
+    InvenioCategory category;
+    GVariantIter *iter;
+    const gchar *name;
+    guint i = 0;
+
+    g_variant_get (parameters, "(as)", &iter);
+
+    /* the order must name every category exactly once */
+    while (g_variant_iter_loop (iter, "&s", &name))
+    {
+        category = invenio_category_from_string (name);
+
+        if (category == INVENIO_CATEGORIES || seen[category] || i == INVENIO_CATEGORIES)
+        {
+            i = 0;
+            break;
+        }
+
+        seen[category] = TRUE;
+        order[i++] = category;
+    }
+
+    g_variant_iter_free (iter);
+
+    if (i != INVENIO_CATEGORIES)
+    {
+        g_dbus_method_invocation_return_error_literal (invocation, G_DBUS_ERROR,
+                                                       G_DBUS_ERROR_INVALID_ARGS,
+                                                       "Invalid category order");
+        return;
+    }
+
+    invenio_configuration_apply_category_order (order);
+    g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static void
+_method_call (GDBusConnection       *connection,
+              const gchar           *sender,
+              const gchar           *object_path,
+              const gchar           *interface_name,
+              const gchar           *method_name,
+              GVariant              *parameters,
+              GDBusMethodInvocation *invocation,
+              gpointer               user_data)
+{
+    /*
+     * Changes are applied to the configuration snapshot in place, which in
+     * turn notifies its watchers (e.g. the hotkey and the search window).  The
+     * preferences tool writes the configuration file itself, so they are not
+     * marked for saving here.
+     */
+    if (g_strcmp0 (method_name, "SetMenuShortcut") == 0)
+        _set_menu_shortcut (parameters, invocation);
+    else if (g_strcmp0 (method_name, "SetSearchCategory") == 0)
+        _set_search_category (parameters, invocation);
+    else if (g_strcmp0 (method_name, "SetCategoryOrder") == 0)
+        _set_category_order (parameters, invocation);
+    else
+        g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                               G_DBUS_ERROR_UNKNOWN_METHOD,
+                                               "Unknown method '%s'", method_name);
+}
+
+static const GDBusInterfaceVTable vtable =
+{
+    _method_call,
+    NULL,
+    NULL,
+};
+
+static void
+_bus_acquired (GDBusConnection  *connection,
+               const gchar      *name,
+               gpointer          user_data)
+{
+    GError *error = NULL;
+
+    g_dbus_connection_register_object (connection,
+                                       INVENIO_REMOTE_PATH,
+                                       remote.node_info->interfaces[0],
+                                       &vtable,
+                                       NULL,
+                                       NULL,
+                                       &error);
+
+    if (error)
+    {
+        g_warning ("Unable to export preferences interface: %s", error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+_name_lost (GDBusConnection *connection,
+            const gchar     *name,
+            gpointer         user_data)
+{
+    g_debug ("Unable to own the name '%s' on the session bus", name);
+}
+
+void
+invenio_remote_export (void)
+{
+    if (remote.owner_id)
+        return;
+
+    remote.node_info = g_dbus_node_info_new_for_xml (introspection, NULL);
+
+    remote.owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
+                                      INVENIO_REMOTE_NAME,
+                                      G_BUS_NAME_OWNER_FLAGS_NONE,
+                                      _bus_acquired,
+                                      NULL,
+                                      _name_lost,
+                                      NULL,
+                                      NULL);
+}
+
+static void
+_call_finished (GObject         *source_object,
+                GAsyncResult    *result,
+                gpointer         user_data)
+{
+    GVariant *reply;
+    GError *error = NULL;
+
+    reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), result, &error);
+
+    if (error)
+    {
+        /* most likely, invenio is simply not running */
+        g_debug ("Unable to update invenio: %s", error->message);
+        g_error_free (error);
+        return;
+    }
+
+    g_variant_unref (reply);
+}
+
+static void
+_call (const gchar * const  method_name,
+       GVariant            *parameters)
+{
+    GError *error = NULL;
+
+    if (! remote.connection)
+    {
+        remote.connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+
+        if (error)
+        {
+            g_debug ("Unable to connect to the session bus: %s", error->message);
+            g_error_free (error);
+            g_variant_unref (g_variant_ref_sink (parameters));
+            return;
+        }
+    }
+
+    g_dbus_connection_call (remote.connection,
+                            INVENIO_REMOTE_NAME,
+                            INVENIO_REMOTE_PATH,
+                            INVENIO_REMOTE_INTERFACE,
+                            method_name,
+                            parameters,
+                            NULL,
+                            G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                            -1,
+                            NULL,
+                            _call_finished,
+                            NULL);
+}
+
+void
+invenio_remote_set_menu_shortcut (const gchar * const menu_shortcut)
+{
+    _call ("SetMenuShortcut", g_variant_new ("(s)", menu_shortcut ? menu_shortcut : ""));
+}
+
+void
+invenio_remote_set_search_category (const InvenioCategory  category,
+                                    const gboolean         enabled)
+{
+    _call ("SetSearchCategory",
+           g_variant_new ("(sb)", invenio_category_to_string (category), enabled));
+}
+
+void
+invenio_remote_set_category_order (const InvenioCategory * const order)
+{
+    GVariantBuilder builder;
+    guint i;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
+
+    for (i = 0; i < INVENIO_CATEGORIES; i++)
+        g_variant_builder_add (&builder, "s", invenio_category_to_string (order[i]));
+
+    _call ("SetCategoryOrder", g_variant_new ("(as)", &builder));
+}